@@ -0,0 +1,815 @@
+#include "../sluggish/rasterizer.hpp"
+#include "../generator/stb_truetype.h"
+#include "../shared.hpp"
+
+#include <Windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+#define FONTGEN_EXE_NAME "fontgen.exe"
+
+// fontgen writes <name>.sluggish in the current directory
+#define SYNTHETIC_FONT_NAME "fontbench_synthetic"
+
+#define BENCH_RESULTS_VERSION 1
+
+/*
+Results file format (.json)
+
+One scenario per line so that baselines can be read back without a JSON parser:
+{
+	"benchmark": "fontbench",
+	"version": 1,
+	"input": "<path>",
+	"scenarios":
+	[
+		{ "name": "<name>", "iterations": <n>, "min_ms": <x>, "median_ms": <x>, "max_ms": <x>, "work": <x>, "unit": "<unit>" },
+		...
+	]
+}
+
+Baselines are compared on median_ms.
+*/
+
+struct BenchResult
+{
+	std::string name;
+	u32 iterations;
+	f64 minMS;
+	f64 medianMS;
+	f64 maxMS;
+	f64 work; // the amount of unit processed by a single iteration
+	const char* unit;
+};
+
+struct BenchBaseline
+{
+	std::string name;
+	f64 medianMS;
+};
+
+struct RenderScenario
+{
+	const char* name;
+	u32 pixels; // the glyphs are fit into pixels*pixels images
+	const char* glyphs; // NULL for all the code points of the font
+};
+
+static const RenderScenario renderScenarios[] =
+{
+	{ "render_16px", 16, NULL },
+	{ "render_64px", 64, NULL },
+	{ "render_256px", 256, NULL },
+	{ "render_2048px", 2048, "Ag@&" }
+};
+
+// synthetic fonts have many more glyphs, so the big sizes are left out
+static const RenderScenario syntheticRenderScenarios[] =
+{
+	{ "synthetic_render_16px", 16, NULL },
+	{ "synthetic_render_64px", 64, NULL }
+};
+
+struct GeneratorScenario
+{
+	const char* name;
+	const char* options;
+	bool synthetic; // generates SYNTHETIC_FONT_NAME instead of reading the input
+};
+
+// the synthetic settings are all spelled out so that changing fontgen's defaults doesn't change the workload
+static const GeneratorScenario generatorScenarios[] =
+{
+	{ "fontgen_inline", "-inline", false },
+	{ "fontgen_indexed", "", false },
+	{ "fontgen_synthetic", "-seed=1 -contours=2,6 -curves=8,32 -curvelength=1,4 -overlap=0.25", true }
+};
+
+// pixels per em of the stb_truetype comparison
+static const u32 compareSizes[] = { 8, 12, 16, 24, 32, 64, 128, 256 };
+
+static const char* const benchText =
+	"The quick brown fox jumps over the lazy dog.\n"
+	"Sphinx of black quartz, judge my vow! 0123456789\n"
+	"(pack) {my} [box] <with> \"five\" dozen 'liquor' jugs; ~#$%^*_+=|/\\?";
+
+
+static f64 GetTimeMS()
+{
+	LARGE_INTEGER time;
+	QueryPerformanceCounter(&time);
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+
+	return (1000.0 * (f64)time.QuadPart) / (f64)freq.QuadPart;
+}
+
+static void AddResult(std::vector<BenchResult>& results, const char* name, std::vector<f64>& samples, f64 work, const char* unit)
+{
+	std::sort(samples.begin(), samples.end());
+
+	BenchResult result;
+	result.name = name;
+	result.iterations = (u32)samples.size();
+	result.minMS = samples.front();
+	result.medianMS = samples[samples.size() / 2];
+	result.maxMS = samples.back();
+	result.work = work;
+	result.unit = unit;
+	results.push_back(result);
+
+	PrintInfo("%-20s %10.3f ms (min %.3f, max %.3f, %u iterations)\n", name, result.medianMS, result.minMS, result.maxMS, result.iterations);
+}
+
+// the child's output goes nowhere
+static bool RunProcess(char* commandLine, f64* durationMS)
+{
+	STARTUPINFOA startupInfo;
+	memset(&startupInfo, 0, sizeof(startupInfo));
+	startupInfo.cb = sizeof(startupInfo);
+	startupInfo.dwFlags = STARTF_USESTDHANDLES;
+
+	PROCESS_INFORMATION processInfo;
+	const f64 start = GetTimeMS();
+	if(!CreateProcessA(NULL, commandLine, NULL, NULL, FALSE, 0, NULL, NULL, &startupInfo, &processInfo))
+	{
+		return false;
+	}
+
+	WaitForSingleObject(processInfo.hProcess, INFINITE);
+	*durationMS = GetTimeMS() - start;
+
+	DWORD exitCode = 1;
+	GetExitCodeProcess(processInfo.hProcess, &exitCode);
+	CloseHandle(processInfo.hThread);
+	CloseHandle(processInfo.hProcess);
+
+	return exitCode == 0;
+}
+
+// fontgen writes <input>.sluggish next to the input, so the last layout benchmarked is the one that stays
+// the synthetic scenarios are skipped when syntheticGlyphs is 0
+static bool BenchGenerator(std::vector<BenchResult>& results, const char* fontgenPath, const char* inputPath, u32 syntheticGlyphs, u32 iterations)
+{
+	for(const auto& scenario : generatorScenarios)
+	{
+		if(scenario.synthetic && syntheticGlyphs == 0)
+		{
+			continue;
+		}
+
+		std::vector<f64> samples;
+		for(u32 i = 0; i < iterations; ++i)
+		{
+			char commandLine[1024];
+			if(scenario.synthetic)
+			{
+				sprintf(commandLine, "\"%s\" %s -synthetic=%u %s", fontgenPath, SYNTHETIC_FONT_NAME, syntheticGlyphs, scenario.options);
+			}
+			else
+			{
+				sprintf(commandLine, "\"%s\" \"%s\" %s", fontgenPath, inputPath, scenario.options);
+			}
+
+			f64 durationMS;
+			if(!RunProcess(commandLine, &durationMS))
+			{
+				PrintError("Failed to run: %s\n", commandLine);
+				return false;
+			}
+			samples.push_back(durationMS);
+		}
+
+		AddResult(results, scenario.name, samples, 1.0, "fonts");
+	}
+
+	return true;
+}
+
+// cold: the first load of the file, warm: all the following ones
+static bool BenchLoading(std::vector<BenchResult>& results, const char* namePrefix, const char* fontPath, u32 iterations)
+{
+	const std::string coldName = std::string(namePrefix) + "load_cold";
+	const std::string warmName = std::string(namePrefix) + "load_warm";
+	std::vector<f64> samples;
+	for(u32 i = 0; i <= iterations; ++i)
+	{
+		Font font;
+		const f64 start = GetTimeMS();
+		if(!font.Load(fontPath, FONT_LOAD_BAND_CURVES))
+		{
+			return false;
+		}
+		samples.push_back(GetTimeMS() - start);
+
+		if(i == 0)
+		{
+			AddResult(results, coldName.c_str(), samples, 1.0, "fonts");
+			samples.clear();
+		}
+	}
+
+	AddResult(results, warmName.c_str(), samples, 1.0, "fonts");
+
+	return true;
+}
+
+static void BenchRendering(std::vector<BenchResult>& results, const Font& font, const RenderScenario* scenarios, u32 scenarioCount, const RasterSettings& settings, u32 iterations)
+{
+	Rasterizer rasterizer;
+	rasterizer.settings = settings;
+	std::vector<u8> image;
+	for(u32 s = 0; s < scenarioCount; ++s)
+	{
+		const RenderScenario& scenario = scenarios[s];
+		std::vector<const SluggishCodePoint*> glyphs;
+		if(scenario.glyphs == NULL)
+		{
+			for(const auto& cp : font.codePoints)
+			{
+				glyphs.push_back(&cp);
+			}
+		}
+		else
+		{
+			for(const char* c = scenario.glyphs; *c != '\0'; ++c)
+			{
+				const SluggishCodePoint* const cp = font.FindCodePoint((u32)(u8)*c);
+				if(cp != NULL)
+				{
+					glyphs.push_back(cp);
+				}
+			}
+		}
+
+		const u32 size = scenario.pixels;
+		image.resize((size_t)size * (size_t)size);
+		std::vector<f64> samples;
+		for(u32 i = 0; i < iterations; ++i)
+		{
+			const f64 start = GetTimeMS();
+			for(const SluggishCodePoint* cp : glyphs)
+			{
+				f32 scaleX, scaleY, offsetX, offsetY;
+				Rasterizer::ComputeGlyphTransform(*cp, size, size, true, 0.0f, 0.0f, &scaleX, &scaleY, &offsetX, &offsetY);
+				rasterizer.Rasterize(font, *cp, &image[0], size, size, scaleX, scaleY, offsetX, offsetY);
+			}
+			samples.push_back(GetTimeMS() - start);
+		}
+
+		AddResult(results, scenario.name, samples, (f64)glyphs.size() * (f64)size * (f64)size, "pixels");
+	}
+}
+
+// lays out benchText on a single image like a text renderer would:
+// every glyph is traced in its own tight box at its sub-pixel position and added to the page
+static void BenchString(std::vector<BenchResult>& results, const Font& font, const RasterSettings& settings, f32 pixelsPerEm, u32 iterations)
+{
+	FontMetrics metrics;
+	font.GetMetrics(metrics, pixelsPerEm);
+	const f32 s = metrics.pixelsPerUnit;
+
+	f32 penX = 0.0f;
+	f32 maxX = 0.0f;
+	u32 lineCount = 1;
+	for(const char* c = benchText; *c != '\0'; ++c)
+	{
+		const SluggishCodePoint* const cp = font.FindCodePoint((u32)(u8)*c);
+		if(*c == '\n')
+		{
+			penX = 0.0f;
+			++lineCount;
+		}
+		else
+		{
+			penX += cp != NULL ? (f32)cp->advance * s : 0.25f * pixelsPerEm;
+			maxX = Max(maxX, penX);
+		}
+	}
+
+	const u32 pageWidth = (u32)ceilf(maxX) + 2;
+	const u32 pageHeight = (u32)ceilf((f32)lineCount * metrics.lineHeight) + 2;
+	std::vector<u8> page((size_t)pageWidth * (size_t)pageHeight);
+	std::vector<u8> scratch;
+	Rasterizer rasterizer;
+	rasterizer.settings = settings;
+
+	u32 glyphCount = 0;
+	std::vector<f64> samples;
+	for(u32 i = 0; i < iterations; ++i)
+	{
+		const f64 start = GetTimeMS();
+		memset(&page[0], 0, page.size());
+		glyphCount = 0;
+		penX = 0.0f;
+		f32 baseline = metrics.ascent;
+		for(const char* c = benchText; *c != '\0'; ++c)
+		{
+			if(*c == '\n')
+			{
+				penX = 0.0f;
+				baseline += metrics.lineHeight;
+				continue;
+			}
+
+			const SluggishCodePoint* const cp = font.FindCodePoint((u32)(u8)*c);
+			if(cp == NULL)
+			{
+				penX += 0.25f * pixelsPerEm;
+				continue;
+			}
+
+			// the page's rows go down, so the box's bottom-left pixel is (x0, y0)
+			// and its bottom-left corner is at (x0, y0 + 1)
+			// the distance from there to the glyph's bounding box is the sub-pixel offset
+			const f32 left = penX + (f32)cp->bearingX * s;
+			const f32 bottom = baseline - (f32)cp->bearingY * s;
+			const s32 x0 = (s32)floorf(left);
+			const s32 y0 = (s32)floorf(bottom);
+			const u32 w = (u32)ceilf((f32)cp->width * s) + 2;
+			const u32 h = (u32)ceilf((f32)cp->height * s) + 2;
+			scratch.resize((size_t)w * (size_t)h);
+			rasterizer.Rasterize(font, *cp, &scratch[0], w, h, 1.0f / s, 1.0f / s, -(left - (f32)x0) / s, -((f32)(y0 + 1) - bottom) / s);
+
+			// the scratch image's top row is the box's top
+			for(u32 y = 0; y < h; ++y)
+			{
+				const s32 pageY = y0 - (s32)(h - 1) + (s32)y;
+				for(u32 x = 0; x < w; ++x)
+				{
+					const s32 pageX = x0 + (s32)x;
+					if(pageX >= 0 && pageX < (s32)pageWidth && pageY >= 0 && pageY < (s32)pageHeight)
+					{
+						u8& pixel = page[(size_t)pageY * pageWidth + (size_t)pageX];
+						pixel = (u8)Min((u32)pixel + (u32)scratch[(size_t)y * w + x], 255u);
+					}
+				}
+			}
+
+			penX += (f32)cp->advance * s;
+			++glyphCount;
+		}
+		samples.push_back(GetTimeMS() - start);
+	}
+
+	char name[64];
+	sprintf(name, "render_string_%gppem", pixelsPerEm);
+	AddResult(results, name, samples, (f64)glyphCount, "glyphs");
+}
+
+struct CompareGlyph
+{
+	const SluggishCodePoint* cp;
+	int glyphIndex;
+	int x0; // stb_truetype's bitmap box, in pixels, y goes down
+	int y1;
+	u32 w;
+	u32 h;
+	size_t offset; // into the images
+};
+
+struct CompareStats
+{
+	u32 pixelsPerEm;
+	u32 glyphCount;
+	f64 pixelCount;
+	f64 sluggishMS;
+	f64 stbMS;
+	u32 maxError; // [0,255]
+	f64 meanError; // [0,255], over the pixels covered by either rasterizer
+};
+
+// renders every glyph at the same sizes with stb_truetype's scanline rasterizer and the Sluggish one:
+// - both use stb_truetype's bitmap boxes and the Sluggish pixel centers are placed on stb_truetype's
+// - stb_truetype's times include fetching and flattening the glyph outlines since its API always does it
+static bool BenchStbComparison(std::vector<BenchResult>& results, const Font& font, const char* ttfPath, const RasterSettings& settings, u32 iterations)
+{
+	Buffer fontFile;
+	if(!ReadEntireFile(fontFile, ttfPath))
+	{
+		PrintError("Failed to load file into memory: %s\n", ttfPath);
+		return false;
+	}
+
+	stbtt_fontinfo info;
+	if(!stbtt_InitFont(&info, (const unsigned char*)fontFile.buffer, 0))
+	{
+		PrintError("Failed to parse font file: %s\n", ttfPath);
+		FreeBuffer(fontFile);
+		return false;
+	}
+
+	Rasterizer rasterizer;
+	rasterizer.settings = settings;
+	std::vector<CompareStats> stats;
+	std::vector<CompareGlyph> glyphs;
+	std::vector<u8> sluggishImages;
+	std::vector<u8> stbImages;
+	for(u32 pixelsPerEm : compareSizes)
+	{
+		const f32 scale = stbtt_ScaleForMappingEmToPixels(&info, (f32)pixelsPerEm);
+		const f32 unitsPerPixel = 1.0f / scale;
+
+		glyphs.clear();
+		size_t pixelCount = 0;
+		for(const auto& cp : font.codePoints)
+		{
+			CompareGlyph glyph;
+			glyph.glyphIndex = stbtt_FindGlyphIndex(&info, (int)cp.codePoint);
+			if(cp.width == 0 || cp.height == 0 || glyph.glyphIndex == 0)
+			{
+				continue;
+			}
+
+			int y0, x1;
+			stbtt_GetGlyphBitmapBox(&info, glyph.glyphIndex, scale, scale, &glyph.x0, &y0, &x1, &glyph.y1);
+			if(x1 <= glyph.x0 || glyph.y1 <= y0)
+			{
+				continue;
+			}
+
+			glyph.cp = &cp;
+			glyph.w = (u32)(x1 - glyph.x0);
+			glyph.h = (u32)(glyph.y1 - y0);
+			glyph.offset = pixelCount;
+			pixelCount += (size_t)glyph.w * (size_t)glyph.h;
+			glyphs.push_back(glyph);
+		}
+
+		if(glyphs.empty())
+		{
+			continue;
+		}
+
+		sluggishImages.resize(pixelCount);
+		stbImages.resize(pixelCount);
+
+		std::vector<f64> sluggishSamples;
+		std::vector<f64> stbSamples;
+		for(u32 i = 0; i < iterations; ++i)
+		{
+			f64 start = GetTimeMS();
+			for(const auto& glyph : glyphs)
+			{
+				// the bottom-left pixel's center, relative to the bottom-left of the glyph's bounding box
+				const f32 offsetX = ((f32)glyph.x0 + 0.5f) * unitsPerPixel - (f32)glyph.cp->bearingX;
+				const f32 offsetY = -((f32)glyph.y1 - 0.5f) * unitsPerPixel - (f32)glyph.cp->bearingY;
+				rasterizer.Rasterize(font, *glyph.cp, &sluggishImages[glyph.offset], glyph.w, glyph.h, unitsPerPixel, unitsPerPixel, offsetX, offsetY);
+			}
+			sluggishSamples.push_back(GetTimeMS() - start);
+
+			start = GetTimeMS();
+			for(const auto& glyph : glyphs)
+			{
+				stbtt_MakeGlyphBitmap(&info, &stbImages[glyph.offset], (int)glyph.w, (int)glyph.h, (int)glyph.w, scale, scale, glyph.glyphIndex);
+			}
+			stbSamples.push_back(GetTimeMS() - start);
+		}
+
+		char name[64];
+		sprintf(name, "cmp_sluggish_%uppem", pixelsPerEm);
+		AddResult(results, name, sluggishSamples, (f64)pixelCount, "pixels");
+		sprintf(name, "cmp_stb_%uppem", pixelsPerEm);
+		AddResult(results, name, stbSamples, (f64)pixelCount, "pixels");
+
+		CompareStats s;
+		s.pixelsPerEm = pixelsPerEm;
+		s.glyphCount = (u32)glyphs.size();
+		s.pixelCount = (f64)pixelCount;
+		s.sluggishMS = results[results.size() - 2].medianMS;
+		s.stbMS = results[results.size() - 1].medianMS;
+		s.maxError = 0;
+		u64 errorSum = 0;
+		u64 coveredCount = 0;
+		for(size_t p = 0; p < pixelCount; ++p)
+		{
+			const u32 a = sluggishImages[p];
+			const u32 b = stbImages[p];
+			if(a == 0 && b == 0)
+			{
+				continue;
+			}
+			const u32 error = a > b ? a - b : b - a;
+			s.maxError = Max(s.maxError, error);
+			errorSum += error;
+			++coveredCount;
+		}
+		s.meanError = coveredCount > 0 ? (f64)errorSum / (f64)coveredCount : 0.0;
+		stats.push_back(s);
+	}
+
+	FreeBuffer(fontFile);
+
+	PrintInfo("\nSluggish vs stb_truetype (throughput in megapixels/s, errors in [0,255])\n");
+	PrintInfo("%5s %7s %10s %10s %8s %8s %9s\n", "ppem", "glyphs", "Sluggish", "stb", "speedup", "max err", "mean err");
+	for(const auto& s : stats)
+	{
+		const f64 sluggishRate = s.sluggishMS > 0.0 ? s.pixelCount / (1000.0 * s.sluggishMS) : 0.0;
+		const f64 stbRate = s.stbMS > 0.0 ? s.pixelCount / (1000.0 * s.stbMS) : 0.0;
+		const f64 speedup = s.sluggishMS > 0.0 ? s.stbMS / s.sluggishMS : 0.0;
+		PrintInfo("%5u %7u %10.2f %10.2f %7.2fx %8u %9.2f\n", s.pixelsPerEm, s.glyphCount, sluggishRate, stbRate, speedup, s.maxError, s.meanError);
+	}
+	PrintInfo("\n");
+
+	return true;
+}
+
+static bool WriteResults(const char* outputPath, const char* inputPath, const std::vector<BenchResult>& results)
+{
+	FILE* const file = fopen(outputPath, "w");
+	if(file == NULL)
+	{
+		PrintError("Failed to open output file: %s\n", outputPath);
+		return false;
+	}
+
+	// JSON strings can't hold raw backslashes
+	std::string input = inputPath;
+	std::replace(input.begin(), input.end(), '\\', '/');
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"benchmark\": \"fontbench\",\n");
+	fprintf(file, "\t\"version\": %d,\n", BENCH_RESULTS_VERSION);
+	fprintf(file, "\t\"input\": \"%s\",\n", input.c_str());
+	fprintf(file, "\t\"scenarios\":\n");
+	fprintf(file, "\t[\n");
+	for(size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchResult& r = results[i];
+		fprintf(file, "\t\t{ \"name\": \"%s\", \"iterations\": %u, \"min_ms\": %.4f, \"median_ms\": %.4f, \"max_ms\": %.4f, \"work\": %.0f, \"unit\": \"%s\" }%s\n",
+				r.name.c_str(), r.iterations, r.minMS, r.medianMS, r.maxMS, r.work, r.unit, i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "\t]\n");
+	fprintf(file, "}\n");
+
+	const bool success = ferror(file) == 0;
+	fclose(file);
+	if(!success)
+	{
+		PrintError("Failed to write output file: %s\n", outputPath);
+	}
+
+	return success;
+}
+
+static bool ReadBaseline(const char* baselinePath, std::vector<BenchBaseline>& baseline)
+{
+	FILE* const file = fopen(baselinePath, "r");
+	if(file == NULL)
+	{
+		PrintError("Failed to open baseline file: %s\n", baselinePath);
+		return false;
+	}
+
+	char line[1024];
+	while(fgets(line, sizeof(line), file) != NULL)
+	{
+		const char* const name = strstr(line, "\"name\": \"");
+		const char* const median = strstr(line, "\"median_ms\": ");
+		char nameValue[64];
+		BenchBaseline entry;
+		if(name != NULL && median != NULL &&
+		   sscanf(name, "\"name\": \"%63[^\"]\"", nameValue) == 1 &&
+		   sscanf(median, "\"median_ms\": %lf", &entry.medianMS) == 1)
+		{
+			entry.name = nameValue;
+			baseline.push_back(entry);
+		}
+	}
+	fclose(file);
+
+	if(baseline.empty())
+	{
+		PrintError("No scenario found in baseline file: %s\n", baselinePath);
+		return false;
+	}
+
+	return true;
+}
+
+// returns the number of regressions
+static u32 CompareToBaseline(const std::vector<BenchResult>& results, const std::vector<BenchBaseline>& baseline, f64 thresholdPercent)
+{
+	u32 regressionCount = 0;
+	for(const auto& r : results)
+	{
+		const BenchBaseline* base = NULL;
+		for(const auto& b : baseline)
+		{
+			if(b.name == r.name)
+			{
+				base = &b;
+				break;
+			}
+		}
+
+		if(base == NULL || base->medianMS <= 0.0)
+		{
+			PrintInfo("%-20s %10.3f ms (no baseline)\n", r.name.c_str(), r.medianMS);
+			continue;
+		}
+
+		const f64 changePercent = 100.0 * (r.medianMS - base->medianMS) / base->medianMS;
+		const bool regressed = changePercent > thresholdPercent;
+		if(regressed)
+		{
+			++regressionCount;
+		}
+		PrintInfo("%-20s %10.3f ms vs %10.3f ms %+7.1f%%%s\n", r.name.c_str(), r.medianMS, base->medianMS, changePercent, regressed ? "  REGRESSION" : "");
+	}
+
+	return regressionCount;
+}
+
+int main(int argc, char** argv)
+{
+	if(ShouldPrintHelp(argc, argv))
+	{
+		printf("Runs the Sluggish benchmark scenarios and writes the results as JSON.\n");
+		printf("\n");
+		printf("%s <input.ttf|input%s> [-iterations=count] [-output=path]\n", GetExecutableFileName(argv[0]), SLUGGISH_EXTENSION_NAME);
+		printf("         [-baseline=path] [-threshold=percent] [-aa=1|2|adaptive] [-stb]\n");
+		printf("         [-synthetic=glyphs]\n");
+		printf("\n");
+		printf("input      With a .ttf file, %s (next to this executable) gets\n", FONTGEN_EXE_NAME);
+		printf("           benchmarked and overwrites the font's %s file.\n", SLUGGISH_EXTENSION_NAME);
+		printf("           With a %s file, generation is skipped.\n", SLUGGISH_EXTENSION_NAME);
+		printf("synthetic  The number of glyphs of the synthetic font that %s\n", FONTGEN_EXE_NAME);
+		printf("           generates as %s%s in the current directory\n", SYNTHETIC_FONT_NAME, SLUGGISH_EXTENSION_NAME);
+		printf("           to be loaded and rendered too. Requires a .ttf input.\n");
+		printf("           By default, it's 1000. 0 skips the synthetic scenarios.\n");
+		printf("iterations The number of runs per scenario, the median is reported.\n");
+		printf("           By default, 5 runs are made.\n");
+		printf("output     The results file. By default, it's 'fontbench.json'.\n");
+		printf("baseline   A results file to compare against.\n");
+		printf("           The exit code is 1 when a scenario regressed.\n");
+		printf("threshold  The slowdown in percent a scenario is allowed before it's\n");
+		printf("           flagged as a regression. By default, it's 10.\n");
+		printf("aa         The anti-aliasing policy of the rendering scenarios.\n");
+		printf("           By default, 2 rays are traced per pixel.\n");
+		printf("stb        Also renders every glyph at several sizes with stb_truetype's\n");
+		printf("           rasterizer and reports the throughput of both and the\n");
+		printf("           coverage errors. Requires a .ttf input.\n");
+		return 1337;
+	}
+
+	u32 iterations = 5;
+	const char* outputPath = "fontbench.json";
+	const char* baselinePath = NULL;
+	f64 thresholdPercent = 10.0;
+	bool compareToStb = false;
+	u32 syntheticGlyphs = 1000;
+	Rasterizer defaultRasterizer;
+	RasterSettings settings = defaultRasterizer.settings;
+	for(int i = 2; i < argc; ++i)
+	{
+		const char* const arg = argv[i];
+		if(strstr(arg, "-iterations=") == arg)
+		{
+			u32 n;
+			if(sscanf(arg, "-iterations=%u", &n) == 1 && n >= 1)
+			{
+				iterations = n;
+			}
+		}
+		else if(strstr(arg, "-output=") == arg)
+		{
+			outputPath = arg + 8;
+		}
+		else if(strstr(arg, "-baseline=") == arg)
+		{
+			baselinePath = arg + 10;
+		}
+		else if(strstr(arg, "-threshold=") == arg)
+		{
+			f64 t;
+			if(sscanf(arg, "-threshold=%lf", &t) == 1 && t >= 0.0)
+			{
+				thresholdPercent = t;
+			}
+		}
+		else if(strcmp(arg, "-stb") == 0)
+		{
+			compareToStb = true;
+		}
+		else if(strstr(arg, "-synthetic=") == arg)
+		{
+			u32 n;
+			if(sscanf(arg, "-synthetic=%u", &n) == 1)
+			{
+				syntheticGlyphs = n;
+			}
+		}
+		else if(strstr(arg, "-aa=") == arg)
+		{
+			if(strcmp(arg + 4, "1") == 0)
+			{
+				settings.aaMode = AA_MODE_1RAY;
+			}
+			else if(strcmp(arg + 4, "2") == 0)
+			{
+				settings.aaMode = AA_MODE_2RAYS;
+			}
+			else if(strcmp(arg + 4, "adaptive") == 0)
+			{
+				settings.aaMode = AA_MODE_ADAPTIVE;
+			}
+		}
+	}
+
+	std::vector<BenchBaseline> baseline;
+	if(baselinePath != NULL && !ReadBaseline(baselinePath, baseline))
+	{
+		return 1;
+	}
+
+	const char* const inputPath = argv[1];
+	std::string fontPath = inputPath;
+	std::vector<BenchResult> results;
+	const size_t l = fontPath.size();
+	const bool isTrueType = l > 4 && (fontPath.compare(l - 4, 4, ".ttf") == 0 || fontPath.compare(l - 4, 4, ".TTF") == 0);
+	if(compareToStb && !isTrueType)
+	{
+		PrintError("-stb requires a .ttf input file\n");
+		return 1;
+	}
+
+	if(isTrueType)
+	{
+		// fontgen lives next to us
+		std::string fontgenPath = argv[0];
+		const size_t slash = fontgenPath.find_last_of("/\\");
+		fontgenPath = (slash == std::string::npos ? std::string() : fontgenPath.substr(0, slash + 1)) + FONTGEN_EXE_NAME;
+
+		if(!BenchGenerator(results, fontgenPath.c_str(), inputPath, syntheticGlyphs, iterations))
+		{
+			return 1;
+		}
+
+		fontPath = fontPath.substr(0, l - 4) + SLUGGISH_EXTENSION_NAME;
+	}
+	else
+	{
+		syntheticGlyphs = 0;
+	}
+
+	if(!BenchLoading(results, "", fontPath.c_str(), iterations))
+	{
+		return 1;
+	}
+
+	Font font;
+	if(!font.Load(fontPath.c_str(), FONT_LOAD_BAND_CURVES))
+	{
+		return 1;
+	}
+
+	BenchRendering(results, font, renderScenarios, (u32)(sizeof(renderScenarios) / sizeof(renderScenarios[0])), settings, iterations);
+	BenchString(results, font, settings, 32.0f, iterations);
+
+	if(syntheticGlyphs > 0)
+	{
+		const char* const syntheticPath = SYNTHETIC_FONT_NAME SLUGGISH_EXTENSION_NAME;
+		if(!BenchLoading(results, "synthetic_", syntheticPath, iterations))
+		{
+			return 1;
+		}
+
+		Font syntheticFont;
+		if(!syntheticFont.Load(syntheticPath, FONT_LOAD_BAND_CURVES))
+		{
+			return 1;
+		}
+
+		BenchRendering(results, syntheticFont, syntheticRenderScenarios, (u32)(sizeof(syntheticRenderScenarios) / sizeof(syntheticRenderScenarios[0])), settings, iterations);
+	}
+
+	if(compareToStb && !BenchStbComparison(results, font, inputPath, settings, iterations))
+	{
+		return 1;
+	}
+
+	if(!WriteResults(outputPath, inputPath, results))
+	{
+		return 1;
+	}
+	PrintInfo("'%s' DONE\n", outputPath);
+
+	if(baselinePath != NULL)
+	{
+		PrintInfo("\nBaseline: %s (threshold: %g%%)\n", baselinePath, thresholdPercent);
+		const u32 regressionCount = CompareToBaseline(results, baseline, thresholdPercent);
+		if(regressionCount > 0)
+		{
+			PrintError("%u scenario(s) regressed by more than %g%%\n", regressionCount, thresholdPercent);
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,4 @@
+#pragma warning(push, 1)
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "../generator/stb_truetype.h"
+#pragma warning(pop)
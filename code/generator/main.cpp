@@ -1,9 +1,13 @@
 ﻿#include "stb_truetype.h"
-#include "../shared.hpp"
+#include "../sluggish/font.hpp"
+#include "../sluggish/rasterizer.hpp"
+#include "../sluggish/trace.hpp"
 
+#include <Windows.h>
 #include <stdio.h>
 #include <assert.h>
 #include <vector>
+#include <queue>
 #include <algorithm>
 
 
@@ -18,86 +22,73 @@ struct Curve
 
 static stbtt_fontinfo g_font;
 static std::vector<Curve> g_curves; // this doesn't get written to the file
+static std::vector<u16> g_glyphCurveLists; // the curve lists of the glyph being encoded
 static std::vector<SluggishCodePoint> g_codePoints;
-static std::vector<u16> g_bandsTextureBandOffsets; // GL_RG16 [curve_count band_offset]
-static std::vector<u16> g_bandsTextureCurveOffsets; // GL_RG16 [curve_offset curve_offset]
+static std::vector<u16> g_bandsTexture; // GL_RG16 per glyph: band headers [curve_count list_offset] then curve lists [curve_offset curve_offset]
 static std::vector<f32> g_curvesTexture; // GL_RGBA32F [x1 y1 x2 y2]
+static std::vector<u16> g_inlineBandOffsets; // GL_RG16 [curve_count curve_offset]
+static std::vector<f32> g_inlineCurvesTexture; // GL_RGBA32F [x1 y1 x2 y2] [x3 y3 0 0]
 static u32 g_ignoredCodePoints = 0;
 static u32 g_bandCount = 16;
+static bool g_normalizedCurves = false;
+static bool g_inlineCurves = false;
 
 
-static bool ProcessCodePoint(int codePoint)
+// both layouts always get built so that we can compare them
+// only the selected one is limited by the 16-bit band offsets
+static void PushInlineCurve(const Curve& c, f32 scaleX, f32 scaleY)
 {
-	const int glyphIdx = stbtt_FindGlyphIndex(&g_font, codePoint);
+	g_inlineCurvesTexture.push_back(c.x1 * scaleX);
+	g_inlineCurvesTexture.push_back(c.y1 * scaleY);
+	g_inlineCurvesTexture.push_back(c.x2 * scaleX);
+	g_inlineCurvesTexture.push_back(c.y2 * scaleY);
+	g_inlineCurvesTexture.push_back(c.x3 * scaleX);
+	g_inlineCurvesTexture.push_back(c.y3 * scaleY);
+	g_inlineCurvesTexture.push_back(0.0f);
+	g_inlineCurvesTexture.push_back(0.0f);
+}
 
-	stbtt_vertex* vertices;
-	const int vertexCount = stbtt_GetGlyphShape(&g_font, glyphIdx, &vertices);
-	if(vertexCount == 0)
-	{
-		PrintWarning("U+%04X has no vertices\n", (unsigned int)codePoint);
-		++g_ignoredCodePoints;
-		return false;
-	}
+static void PushInlineBand(u16 curveCount, u32 texelOffset)
+{
+	g_inlineBandOffsets.push_back(curveCount);
+	g_inlineBandOffsets.push_back((u16)texelOffset);
+}
 
-	// we don't support cubic Bézier curves
-	for(int v = 0; v < vertexCount; ++v)
+// the offsets are relative to the glyph's data, so only a single glyph's data is limited
+static bool FitsBandOffsets(u32 bandCount, u32 curvesTexelIndex)
+{
+	if(g_inlineCurves)
 	{
-		if(vertices[v].type == STBTT_vcubic)
-		{
-			PrintWarning("U+%04X has bicubic curves\n", (unsigned int)codePoint);
-			++g_ignoredCodePoints;
-			return false;
-		}
+		// relative to the glyph's 1st curve
+		return (g_inlineCurvesTexture.size() / 4) - curvesTexelIndex < 0xFFFF;
 	}
 
-	// get the glyph's visible data bounding box
-	int igx1, igy1, igx2, igy2;
-	stbtt_GetGlyphBox(&g_font, glyphIdx, &igx1, &igy1, &igx2, &igy2);
-	const f32 gx1 = (f32)igx1;
-	const f32 gy1 = (f32)igy1;
-
-	//
-	// build temporary curve list
-	//
+	// relative to the glyph's 1st band header
+	return 2 * bandCount + g_glyphCurveLists.size() / 2 < 0xFFFF;
+}
 
-	Curve curve = { 0 };
-	curve.first = false;
-	g_curves.clear();
-	for(int v = 0; v < vertexCount; ++v)
+static void FatalBandOffsetsError()
+{
+	if(g_inlineCurves)
 	{
-		const stbtt_vertex& vert = vertices[v];
-		if(vert.type == STBTT_vcurve)
-		{
-			curve.x1 = curve.x3;
-			curve.y1 = curve.y3;
-			curve.x2 = (f32)vert.cx - gx1;
-			curve.y2 = (f32)vert.cy - gy1;
-			curve.x3 = (f32)vert.x - gx1;
-			curve.y3 = (f32)vert.y - gy1;
-			g_curves.push_back(curve);
-			curve.first = false;
-		}
-		else if(vert.type == STBTT_vline)
-		{
-			curve.x1 = curve.x3;
-			curve.y1 = curve.y3;
-			curve.x3 = (f32)vert.x - gx1;
-			curve.y3 = (f32)vert.y - gy1;
-			curve.x2 = floorf((curve.x1 + curve.x3) / 2.0f);
-			curve.y2 = floorf((curve.y1 + curve.y3) / 2.0f);
-			g_curves.push_back(curve);
-			curve.first = false;
-		}
-		else if(vert.type == STBTT_vmove)
-		{
-			curve.first = true;
-			curve.x3 = (f32)vert.x - gx1;
-			curve.y3 = (f32)vert.y - gy1;
-		}
+		FatalError("Too much data generated to be indexed! Try a lower band count.\n");
 	}
 
+	FatalError("Too much data generated to be indexed! Try a lower band count or the inline layout.\n");
+}
+
+// encodes the glyph described by g_curves, whose coordinates are relative to the bottom-left of its bounding box
+// the bounding box and the advance are in font units
+// returns false when the glyph has too much data for the band offsets, in which case it's only partially written
+static bool EncodeGlyph(u32 codePoint, int igx1, int igy1, int igx2, int igy2, int advanceWidth, u32 maxBandCount)
+{
+	TRACE_ZONE("EncodeGlyph");
+
 	const f32 fbandDelta = 0.0f;
-	const u32 bandsTexelIndex = (u32)(g_bandsTextureBandOffsets.size() / 2);
+	const u32 bandsTexelIndex = (u32)(g_bandsTexture.size() / 2);
+	const u32 inlineBandsTexelIndex = (u32)(g_inlineBandOffsets.size() / 2);
+	const u32 curvesTexelIndex = (u32)(g_inlineCurvesTexture.size() / 4);
+	g_glyphCurveLists.clear();
 
 	//
 	// fix up curves where the control point is one of the endpoints
@@ -117,6 +108,9 @@ static bool ProcessCodePoint(int codePoint)
 	// write curves texture
 	//
 
+	// the bands are built from the curves in font units, only the texture data gets normalized
+	const f32 curveScaleX = g_normalizedCurves ? (1.0f / (f32)Max(igx2 - igx1, 1)) : 1.0f;
+	const f32 curveScaleY = g_normalizedCurves ? (1.0f / (f32)Max(igy2 - igy1, 1)) : 1.0f;
 	for(auto& c : g_curves)
 	{
 		// make sure we start a curve at a texel's boundary
@@ -129,24 +123,13 @@ static bool ProcessCodePoint(int codePoint)
 			}
 		}
 
-		// make sure a curve doesn't cross a row boundary
-		const bool newRow = (g_curvesTexture.size() / 4) % TEXTURE_WIDTH == TEXTURE_WIDTH - 1;
-		if(newRow)
-		{
-			const size_t toAdd = 8 - (g_curvesTexture.size() % 4);
-			for(size_t i = 0; i < toAdd; ++i)
-			{
-				g_curvesTexture.push_back(-1.0f);
-			}
-		}
-
 		// [A1 B1] [C1=A2 B2] [C2=A3 B3] ...
-		if(c.first || newRow)
+		if(c.first)
 		{
 			c.texelIndex = (u32)g_curvesTexture.size() / 4;
 			assert(g_curvesTexture.size() % 4 == 0);
-			g_curvesTexture.push_back(c.x1);
-			g_curvesTexture.push_back(c.y1);
+			g_curvesTexture.push_back(c.x1 * curveScaleX);
+			g_curvesTexture.push_back(c.y1 * curveScaleY);
 		}
 		else
 		{
@@ -154,15 +137,15 @@ static bool ProcessCodePoint(int codePoint)
 		}
 		
 		assert(g_curvesTexture.size() % 2 == 0);
-		g_curvesTexture.push_back(c.x2);
-		g_curvesTexture.push_back(c.y2);
-		g_curvesTexture.push_back(c.x3);
-		g_curvesTexture.push_back(c.y3);
+		g_curvesTexture.push_back(c.x2 * curveScaleX);
+		g_curvesTexture.push_back(c.y2 * curveScaleY);
+		g_curvesTexture.push_back(c.x3 * curveScaleX);
+		g_curvesTexture.push_back(c.y3 * curveScaleY);
 	}
 
 	const u32 sizeX = 1 + (u32)(igx2 - igx1);
 	const u32 sizeY = 1 + (u32)(igy2 - igy1);
-	u32 bandCount = g_bandCount;
+	u32 bandCount = maxBandCount;
 	if(sizeX < bandCount || sizeY < bandCount)
 	{
 		bandCount = Min(sizeX, sizeY) / 2;
@@ -179,7 +162,9 @@ static bool ProcessCodePoint(int codePoint)
 	std::stable_sort(std::begin(g_curves), std::end(g_curves), [](const Curve& a, const Curve& b) { return Max(a.x1, a.x2, a.x3) > Max(b.x1, b.x2, b.x3); });
 	for(u32 b = 0; b < bandCount; ++b)
 	{
-		u16 bandTexelOffset = (u16)(g_bandsTextureCurveOffsets.size() / 2); // 2x 16 bits
+		// the curve lists follow the glyph's 2 * bandCount band headers
+		const u32 bandTexelOffset = 2 * bandCount + (u32)(g_glyphCurveLists.size() / 2);
+		const u32 inlineTexelOffset = (u32)(g_inlineCurvesTexture.size() / 4) - curvesTexelIndex;
 		u16 curveCount = 0;
 
 		for(const auto& c : g_curves)
@@ -198,12 +183,11 @@ static bool ProcessCodePoint(int codePoint)
 				continue;
 			}
 
-			// push the curve offsets
+			// push the curve's texel index
 			const u32 texelIndex = c.texelIndex;
-			const u16 curveOffsetX = (u16)(texelIndex % (u32)TEXTURE_WIDTH);
-			const u16 curveOffsetY = (u16)(texelIndex / (u32)TEXTURE_WIDTH);
-			g_bandsTextureCurveOffsets.push_back(curveOffsetX);
-			g_bandsTextureCurveOffsets.push_back(curveOffsetY);
+			g_glyphCurveLists.push_back((u16)(texelIndex & 0xFFFF));
+			g_glyphCurveLists.push_back((u16)(texelIndex >> 16));
+			PushInlineCurve(c, curveScaleX, curveScaleY);
 
 			++curveCount;
 		}
@@ -211,16 +195,16 @@ static bool ProcessCodePoint(int codePoint)
 		// @TODO: don't push more data if this band is the same as the previous one
 
 		// push the horizontal band
-		g_bandsTextureBandOffsets.push_back(curveCount);
-		g_bandsTextureBandOffsets.push_back(bandTexelOffset);
+		g_bandsTexture.push_back(curveCount);
+		g_bandsTexture.push_back((u16)bandTexelOffset);
+		PushInlineBand(curveCount, inlineTexelOffset);
 
 		bandMinY += fbandDimY;
 		bandMaxY += fbandDimY;
 
-		if(bandTexelOffset >= 0xFFFF ||
-		   g_bandsTextureCurveOffsets.size() / 2 >= 0xFFFF)
+		if(!FitsBandOffsets(bandCount, curvesTexelIndex))
 		{
-			FatalError("Too much data generated to be indexed! Try a lower band count.\n");
+			return false;
 		}
 	}
 
@@ -235,7 +219,9 @@ static bool ProcessCodePoint(int codePoint)
 	std::stable_sort(std::begin(g_curves), std::end(g_curves), [](const Curve& a, const Curve& b) { return Max(a.y1, a.y2, a.y3) > Max(b.y1, b.y2, b.y3); });
 	for(u32 b = 0; b < bandCount; ++b)
 	{
-		u16 bandTexelOffset = (u16)(g_bandsTextureCurveOffsets.size() / 2); // 2x 16 bits
+		// the curve lists follow the glyph's 2 * bandCount band headers
+		const u32 bandTexelOffset = 2 * bandCount + (u32)(g_glyphCurveLists.size() / 2);
+		const u32 inlineTexelOffset = (u32)(g_inlineCurvesTexture.size() / 4) - curvesTexelIndex;
 		u16 curveCount = 0;
 
 		for(const auto& c : g_curves)
@@ -254,12 +240,11 @@ static bool ProcessCodePoint(int codePoint)
 				continue;
 			}
 
-			// push the curve offsets
+			// push the curve's texel index
 			const u32 texelIndex = c.texelIndex;
-			const u16 curveOffsetX = (u16)(texelIndex % (u32)TEXTURE_WIDTH);
-			const u16 curveOffsetY = (u16)(texelIndex / (u32)TEXTURE_WIDTH);
-			g_bandsTextureCurveOffsets.push_back(curveOffsetX);
-			g_bandsTextureCurveOffsets.push_back(curveOffsetY);
+			g_glyphCurveLists.push_back((u16)(texelIndex & 0xFFFF));
+			g_glyphCurveLists.push_back((u16)(texelIndex >> 16));
+			PushInlineCurve(c, curveScaleX, curveScaleY);
 
 			++curveCount;
 		}
@@ -267,19 +252,22 @@ static bool ProcessCodePoint(int codePoint)
 		// @TODO: don't push more data if this band is the same as the previous one
 
 		// push the vertical band
-		g_bandsTextureBandOffsets.push_back(curveCount);
-		g_bandsTextureBandOffsets.push_back(bandTexelOffset);
+		g_bandsTexture.push_back(curveCount);
+		g_bandsTexture.push_back((u16)bandTexelOffset);
+		PushInlineBand(curveCount, inlineTexelOffset);
 
 		bandMinX += fbandDimX;
 		bandMaxX += fbandDimX;
 
-		if(bandTexelOffset >= 0xFFFF ||
-		   g_bandsTextureCurveOffsets.size() / 2 >= 0xFFFF)
+		if(!FitsBandOffsets(bandCount, curvesTexelIndex))
 		{
-			FatalError("Too much data generated to be indexed! Try a lower band count.\n");
+			return false;
 		}
 	}
 
+	// the headers of both band directions are in, the curve lists go right after them
+	g_bandsTexture.insert(g_bandsTexture.end(), g_glyphCurveLists.begin(), g_glyphCurveLists.end());
+
 	//
 	// push the code point
 	//
@@ -291,44 +279,711 @@ static bool ProcessCodePoint(int codePoint)
 	cp.bandCount = bandCount;
 	cp.bandDimX = bandDimX;
 	cp.bandDimY = bandDimY;
-	cp.bandsTexCoordX = (u16)(bandsTexelIndex % (u32)TEXTURE_WIDTH);
-	cp.bandsTexCoordY = (u16)(bandsTexelIndex / (u32)TEXTURE_WIDTH);
+	cp.bandsTexelIndex = g_inlineCurves ? inlineBandsTexelIndex : bandsTexelIndex;
+	cp.curvesTexelIndex = g_inlineCurves ? curvesTexelIndex : 0;
+	cp.bearingX = (s16)igx1;
+	cp.bearingY = (s16)igy1;
+	cp.advance = (u16)advanceWidth;
 	g_codePoints.push_back(cp);
 
-	if(bandsTexelIndex / (u32)TEXTURE_WIDTH >= 0xFFFF)
+	return true;
+}
+
+
+//
+// autotune mode: each glyph gets the band count that the CPU rasterizer renders the fastest within a size budget
+//
+
+#define AUTOTUNE_MAX_SIZES	4
+#define AUTOTUNE_RUNS		5		// the fastest run of every measurement is kept
+#define AUTOTUNE_MIN_GAIN	0.02	// smaller speed-ups are considered noise
+
+// the band counts tried, on top of -bands
+static const u32 g_autotuneBandCounts[] = { 1, 2, 3, 4, 6, 8, 12, 16, 24, 32 };
+
+struct AutotuneCandidate
+{
+	u32 maxBandCount; // what EncodeGlyph got
+	u32 bandCount; // what it used, small glyphs get fewer bands
+	u32 bytes; // band and curve data in the selected layout
+	f64 renderMS; // summed over the target sizes, negative when it couldn't be measured
+};
+
+struct AutotuneGlyph
+{
+	u32 codePoint;
+	int igx1, igy1, igx2, igy2;
+	int advanceWidth;
+	std::vector<Curve> curves; // before EncodeGlyph fixed them up and sorted them
+	std::vector<AutotuneCandidate> candidates; // growing in size and shrinking in render time
+	AutotuneCandidate baseline; // encoded with -bands
+	u32 selected; // index into candidates
+};
+
+// growing a glyph's data to its next candidate
+struct AutotuneUpgrade
+{
+	f64 gainPerByte; // render time saved per byte added
+	u32 glyphIndex;
+
+	bool operator<(const AutotuneUpgrade& other) const
+	{
+		return gainPerByte < other.gainPerByte;
+	}
+};
+
+struct AutotuneSettings
+{
+	u32 sizeCount; // 0 when disabled
+	u32 pixelsPerEm[AUTOTUNE_MAX_SIZES];
+	f32 budget; // relative to the data size of the -bands encoding
+	u32 unitsPerEm;
+};
+
+static AutotuneSettings g_autotune = { 0, { 0 }, 1.0f, 0 };
+static std::vector<AutotuneGlyph> g_autotuneGlyphs;
+static Font g_autotuneFont; // the glyph being measured
+static Rasterizer g_autotuneRasterizer;
+static std::vector<u8> g_autotuneImage;
+static std::vector<f32> g_autotuneCurves; // the glyph being measured, in the layout being written
+static std::vector<u16> g_autotuneBands;
+
+
+static f64 GetTimeMS()
+{
+	LARGE_INTEGER time;
+	QueryPerformanceCounter(&time);
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+
+	return (1000.0 * (f64)time.QuadPart) / (f64)freq.QuadPart;
+}
+
+// renders the glyph EncodeGlyph just pushed at every target size, from the layout being written
+// curvesSize and bandsSize: sizes of that layout's textures before the glyph got pushed
+// returns a negative time when the glyph has no data to measure
+static f64 MeasureEncodedGlyph(size_t curvesSize, size_t bandsSize)
+{
+	SluggishCodePoint cp = g_codePoints.back();
+	cp.bandsTexelIndex = 0;
+	cp.curvesTexelIndex = 0;
+
+	if(g_inlineCurves)
+	{
+		// the band offsets are relative to the glyph's 1st curve already
+		g_autotuneCurves.assign(g_inlineCurvesTexture.begin() + curvesSize, g_inlineCurvesTexture.end());
+		g_autotuneBands.assign(g_inlineBandOffsets.begin() + bandsSize, g_inlineBandOffsets.end());
+	}
+	else
+	{
+		// the curve lists index the whole curves texture, so they get rebased on the glyph's 1st referenced texel
+		g_autotuneBands.assign(g_bandsTexture.begin() + bandsSize, g_bandsTexture.end());
+		u32 firstTexel = 0xFFFFFFFF;
+		for(size_t i = 4 * (size_t)cp.bandCount; i + 1 < g_autotuneBands.size(); i += 2)
+		{
+			firstTexel = Min(firstTexel, (u32)g_autotuneBands[i] | ((u32)g_autotuneBands[i + 1] << 16));
+		}
+		if(firstTexel == 0xFFFFFFFF)
+		{
+			return -1.0;
+		}
+
+		for(size_t i = 4 * (size_t)cp.bandCount; i + 1 < g_autotuneBands.size(); i += 2)
+		{
+			const u32 texelIndex = ((u32)g_autotuneBands[i] | ((u32)g_autotuneBands[i + 1] << 16)) - firstTexel;
+			g_autotuneBands[i + 0] = (u16)(texelIndex & 0xFFFF);
+			g_autotuneBands[i + 1] = (u16)(texelIndex >> 16);
+		}
+
+		// the last curve's 2nd texel is only half used
+		g_autotuneCurves.assign(g_curvesTexture.begin() + 4 * (size_t)firstTexel, g_curvesTexture.end());
+		while(g_autotuneCurves.size() % 4 != 0)
+		{
+			g_autotuneCurves.push_back(-1.0f);
+		}
+	}
+
+	const u32 curvesTexels = (u32)(g_autotuneCurves.size() / 4);
+	const u32 bandsTexels = (u32)(g_autotuneBands.size() / 2);
+	if(curvesTexels == 0 || bandsTexels == 0)
+	{
+		return -1.0;
+	}
+
+	SluggishFontInfo fontInfo;
+	memset(&fontInfo, 0, sizeof(fontInfo));
+	fontInfo.unitsPerEm = (u16)g_autotune.unitsPerEm;
+	fontInfo.flags = 0;
+	fontInfo.flags |= g_normalizedCurves ? SLUGGISH_FLAG_NORMALIZED_CURVES : 0;
+	fontInfo.flags |= g_inlineCurves ? SLUGGISH_FLAG_INLINE_CURVES : 0;
+	if(!g_autotuneFont.Create(fontInfo, &cp, 1, &g_autotuneCurves[0], curvesTexels, &g_autotuneBands[0], bandsTexels, FONT_LOAD_BAND_CURVES))
+	{
+		FatalError("Failed to create a font from the data of U+%04X\n", (unsigned int)cp.codePoint);
+	}
+
+	f64 totalMS = 0.0;
+	for(u32 s = 0; s < g_autotune.sizeCount; ++s)
+	{
+		const f32 pixelsPerUnit = (f32)g_autotune.pixelsPerEm[s] / (f32)g_autotune.unitsPerEm;
+		const u32 w = (u32)ceilf((f32)cp.width * pixelsPerUnit) + 1;
+		const u32 h = (u32)ceilf((f32)cp.height * pixelsPerUnit) + 1;
+		g_autotuneImage.resize((size_t)w * (size_t)h);
+
+		f64 bestMS = 0.0;
+		for(u32 r = 0; r < AUTOTUNE_RUNS; ++r)
+		{
+			const f64 start = GetTimeMS();
+			g_autotuneRasterizer.Rasterize(g_autotuneFont, g_autotuneFont.codePoints[0], &g_autotuneImage[0], w, h, 1.0f / pixelsPerUnit, 1.0f / pixelsPerUnit, 0.0f, 0.0f);
+			const f64 durationMS = GetTimeMS() - start;
+			bestMS = r == 0 ? durationMS : Min(bestMS, durationMS);
+		}
+		totalMS += bestMS;
+	}
+
+	return totalMS;
+}
+
+// only keeps the candidates worth growing the glyph's data for:
+// every candidate is bigger and faster than the previous one and saves less time per added byte
+static void PruneCandidates(std::vector<AutotuneCandidate>& candidates)
+{
+	std::stable_sort(std::begin(candidates), std::end(candidates), [](const AutotuneCandidate& a, const AutotuneCandidate& b)
+	{
+		return a.bytes < b.bytes || (a.bytes == b.bytes && a.renderMS < b.renderMS);
+	});
+
+	std::vector<AutotuneCandidate> kept;
+	for(const auto& c : candidates)
+	{
+		if(!kept.empty() && c.renderMS > kept.back().renderMS * (1.0 - AUTOTUNE_MIN_GAIN))
+		{
+			continue;
+		}
+
+		while(kept.size() >= 2)
+		{
+			const AutotuneCandidate& a = kept[kept.size() - 2];
+			const AutotuneCandidate& b = kept.back();
+			const f64 gainAB = (a.renderMS - b.renderMS) / (f64)(b.bytes - a.bytes);
+			const f64 gainAC = (a.renderMS - c.renderMS) / (f64)(c.bytes - a.bytes);
+			if(gainAB > gainAC)
+			{
+				break;
+			}
+			kept.pop_back();
+		}
+		kept.push_back(c);
+	}
+
+	candidates.swap(kept);
+}
+
+// encodes the glyph with every candidate band count, measures each encoding and rolls it back
+static void MeasureGlyph(AutotuneGlyph& glyph)
+{
+	TRACE_ZONE("MeasureGlyph");
+
+	const size_t curvesSize = g_curvesTexture.size();
+	const size_t bandsSize = g_bandsTexture.size();
+	const size_t inlineCurvesSize = g_inlineCurvesTexture.size();
+	const size_t inlineBandsSize = g_inlineBandOffsets.size();
+	const size_t codePointCount = g_codePoints.size();
+
+	const u32 triedCount = (u32)(sizeof(g_autotuneBandCounts) / sizeof(g_autotuneBandCounts[0]));
+	for(u32 i = 0; i <= triedCount; ++i)
+	{
+		// -bands goes first: it's the baseline of the budget and has to fit like in the normal mode
+		const u32 maxBandCount = i == 0 ? g_bandCount : g_autotuneBandCounts[i - 1];
+		if(i > 0 && maxBandCount == g_bandCount)
+		{
+			continue;
+		}
+
+		g_curves = glyph.curves;
+		const bool encoded = EncodeGlyph(glyph.codePoint, glyph.igx1, glyph.igy1, glyph.igx2, glyph.igy2, glyph.advanceWidth, maxBandCount);
+		if(!encoded && i == 0)
+		{
+			FatalBandOffsetsError();
+		}
+
+		if(encoded)
+		{
+			AutotuneCandidate candidate;
+			candidate.maxBandCount = maxBandCount;
+			candidate.bandCount = g_codePoints.back().bandCount;
+			candidate.renderMS = 0.0;
+			if(g_inlineCurves)
+			{
+				candidate.bytes = (u32)((g_inlineCurvesTexture.size() - inlineCurvesSize) * sizeof(f32) + (g_inlineBandOffsets.size() - inlineBandsSize) * sizeof(u16));
+			}
+			else
+			{
+				candidate.bytes = (u32)((g_curvesTexture.size() - curvesSize) * sizeof(f32) + (g_bandsTexture.size() - bandsSize) * sizeof(u16));
+			}
+
+			bool measured = false;
+			for(const auto& c : glyph.candidates)
+			{
+				measured |= c.bandCount == candidate.bandCount;
+			}
+
+			if(!measured)
+			{
+				candidate.renderMS = g_inlineCurves ? MeasureEncodedGlyph(inlineCurvesSize, inlineBandsSize) : MeasureEncodedGlyph(curvesSize, bandsSize);
+				if(i == 0)
+				{
+					glyph.baseline = candidate;
+				}
+				if(candidate.renderMS >= 0.0)
+				{
+					glyph.candidates.push_back(candidate);
+				}
+			}
+		}
+
+		g_curvesTexture.resize(curvesSize);
+		g_bandsTexture.resize(bandsSize);
+		g_inlineCurvesTexture.resize(inlineCurvesSize);
+		g_inlineBandOffsets.resize(inlineBandsSize);
+		g_codePoints.resize(codePointCount);
+	}
+
+	// nothing could be measured: the glyph keeps its -bands encoding and stays out of the totals
+	if(glyph.candidates.empty())
+	{
+		glyph.candidates.push_back(glyph.baseline);
+	}
+
+	g_curves = glyph.curves;
+	PruneCandidates(glyph.candidates);
+	glyph.selected = 0;
+}
+
+// encodes the glyph described by g_curves right away, or only measures it in autotune mode
+static void AddGlyph(u32 codePoint, int igx1, int igy1, int igx2, int igy2, int advanceWidth)
+{
+	if(g_autotune.sizeCount == 0)
+	{
+		if(!EncodeGlyph(codePoint, igx1, igy1, igx2, igy2, advanceWidth, g_bandCount))
+		{
+			FatalBandOffsetsError();
+		}
+		return;
+	}
+
+	g_autotuneGlyphs.push_back(AutotuneGlyph());
+	AutotuneGlyph& glyph = g_autotuneGlyphs.back();
+	glyph.codePoint = codePoint;
+	glyph.igx1 = igx1;
+	glyph.igy1 = igy1;
+	glyph.igx2 = igx2;
+	glyph.igy2 = igy2;
+	glyph.advanceWidth = advanceWidth;
+	glyph.curves = g_curves;
+	MeasureGlyph(glyph);
+}
+
+static void PushUpgrade(std::priority_queue<AutotuneUpgrade>& upgrades, u32 glyphIndex)
+{
+	const AutotuneGlyph& glyph = g_autotuneGlyphs[glyphIndex];
+	if(glyph.selected + 1 >= (u32)glyph.candidates.size())
+	{
+		return;
+	}
+
+	const AutotuneCandidate& current = glyph.candidates[glyph.selected];
+	const AutotuneCandidate& next = glyph.candidates[glyph.selected + 1];
+	if(current.renderMS < 0.0 || next.renderMS < 0.0)
+	{
+		return;
+	}
+
+	AutotuneUpgrade upgrade;
+	upgrade.gainPerByte = (current.renderMS - next.renderMS) / (f64)(next.bytes - current.bytes);
+	upgrade.glyphIndex = glyphIndex;
+	upgrades.push(upgrade);
+}
+
+// starts from every glyph's smallest encoding and keeps growing the one that saves
+// the most render time per added byte until the budget is spent, then encodes them all
+static void EncodeAutotunedGlyphs()
+{
+	TRACE_ZONE("EncodeAutotunedGlyphs");
+
+	if(g_autotuneGlyphs.empty())
+	{
+		return;
+	}
+
+	u64 baselineBytes = 0;
+	u64 bytes = 0;
+	std::priority_queue<AutotuneUpgrade> upgrades;
+	for(u32 g = 0; g < (u32)g_autotuneGlyphs.size(); ++g)
+	{
+		const AutotuneGlyph& glyph = g_autotuneGlyphs[g];
+		baselineBytes += (u64)glyph.baseline.bytes;
+		bytes += (u64)glyph.candidates[0].bytes;
+		PushUpgrade(upgrades, g);
+	}
+
+	const u64 budgetBytes = (u64)((f64)baselineBytes * (f64)g_autotune.budget);
+	if(bytes > budgetBytes)
+	{
+		PrintWarning("The budget is too small, the smallest encodings take %.1f KB\n", (f64)bytes / 1024.0);
+	}
+
+	while(!upgrades.empty())
+	{
+		const AutotuneUpgrade upgrade = upgrades.top();
+		upgrades.pop();
+
+		AutotuneGlyph& glyph = g_autotuneGlyphs[upgrade.glyphIndex];
+		const u64 addedBytes = (u64)(glyph.candidates[glyph.selected + 1].bytes - glyph.candidates[glyph.selected].bytes);
+		if(bytes + addedBytes > budgetBytes)
+		{
+			continue;
+		}
+
+		bytes += addedBytes;
+		++glyph.selected;
+		PushUpgrade(upgrades, upgrade.glyphIndex);
+	}
+
+	// the render times only compare the glyphs measured with both band counts
+	f64 renderMS = 0.0;
+	f64 baselineMS = 0.0;
+	u32 unmeasuredGlyphs = 0;
+	u32 glyphsPerBandCount[33] = { 0 };
+	for(const auto& glyph : g_autotuneGlyphs)
+	{
+		const AutotuneCandidate& c = glyph.candidates[glyph.selected];
+		g_curves = glyph.curves;
+		if(!EncodeGlyph(glyph.codePoint, glyph.igx1, glyph.igy1, glyph.igx2, glyph.igy2, glyph.advanceWidth, c.maxBandCount))
+		{
+			FatalBandOffsetsError();
+		}
+
+		if(c.renderMS >= 0.0 && glyph.baseline.renderMS >= 0.0)
+		{
+			renderMS += c.renderMS;
+			baselineMS += glyph.baseline.renderMS;
+		}
+		else
+		{
+			++unmeasuredGlyphs;
+		}
+		++glyphsPerBandCount[Min(c.bandCount, 32u)];
+	}
+
+	PrintInfo("Autotune: %.1f KB of band and curve data, %.1f KB with -bands=%u\n", (f64)bytes / 1024.0, (f64)baselineBytes / 1024.0, (unsigned int)g_bandCount);
+	PrintInfo("Autotune: %.3f ms to render every glyph once per size, %.3f ms with -bands=%u\n", renderMS, baselineMS, (unsigned int)g_bandCount);
+	if(unmeasuredGlyphs > 0)
+	{
+		PrintWarning("Autotune: %u glyphs couldn't be measured and aren't part of the render times\n", (unsigned int)unmeasuredGlyphs);
+	}
+
+	char line[1024];
+	int length = sprintf(line, "Autotune: glyphs per band count:");
+	for(u32 b = 0; b <= 32; ++b)
+	{
+		if(glyphsPerBandCount[b] > 0)
+		{
+			length += sprintf(line + length, " %u:%u", (unsigned int)b, (unsigned int)glyphsPerBandCount[b]);
+		}
+	}
+	PrintInfo("%s\n", line);
+
+	std::vector<AutotuneGlyph>().swap(g_autotuneGlyphs);
+}
+
+static bool ProcessCodePoint(int codePoint)
+{
+	TRACE_ZONE("ProcessCodePoint");
+
+	const int glyphIdx = stbtt_FindGlyphIndex(&g_font, codePoint);
+
+	stbtt_vertex* vertices;
+	const int vertexCount = stbtt_GetGlyphShape(&g_font, glyphIdx, &vertices);
+	if(vertexCount == 0)
 	{
-		FatalError("Too much curve data generated! :-(\n");
+		PrintWarning("U+%04X has no vertices\n", (unsigned int)codePoint);
+		++g_ignoredCodePoints;
+		return false;
 	}
 
+	// we don't support cubic Bézier curves
+	for(int v = 0; v < vertexCount; ++v)
+	{
+		if(vertices[v].type == STBTT_vcubic)
+		{
+			PrintWarning("U+%04X has bicubic curves\n", (unsigned int)codePoint);
+			++g_ignoredCodePoints;
+			return false;
+		}
+	}
+
+	// get the glyph's visible data bounding box
+	int igx1, igy1, igx2, igy2;
+	stbtt_GetGlyphBox(&g_font, glyphIdx, &igx1, &igy1, &igx2, &igy2);
+	const f32 gx1 = (f32)igx1;
+	const f32 gy1 = (f32)igy1;
+
+	int advanceWidth, leftSideBearing;
+	stbtt_GetGlyphHMetrics(&g_font, glyphIdx, &advanceWidth, &leftSideBearing);
+
 	//
-	// check the data's validity
+	// build temporary curve list
 	//
 
-	for(const auto& c : g_curves)
+	Curve curve = { 0 };
+	curve.first = false;
+	g_curves.clear();
+	for(int v = 0; v < vertexCount; ++v)
 	{
-		const bool sameRow = c.texelIndex / TEXTURE_WIDTH == (c.texelIndex + 1) / TEXTURE_WIDTH;
-		if(!sameRow)
+		const stbtt_vertex& vert = vertices[v];
+		if(vert.type == STBTT_vcurve)
 		{
-			PrintWarning("U+%04X encoding failed! Texel indices %u and %u are not in the same row\n",
-						 (unsigned int)codePoint, (unsigned int)c.texelIndex, (unsigned int)c.texelIndex + 1);
+			curve.x1 = curve.x3;
+			curve.y1 = curve.y3;
+			curve.x2 = (f32)vert.cx - gx1;
+			curve.y2 = (f32)vert.cy - gy1;
+			curve.x3 = (f32)vert.x - gx1;
+			curve.y3 = (f32)vert.y - gy1;
+			g_curves.push_back(curve);
+			curve.first = false;
+		}
+		else if(vert.type == STBTT_vline)
+		{
+			curve.x1 = curve.x3;
+			curve.y1 = curve.y3;
+			curve.x3 = (f32)vert.x - gx1;
+			curve.y3 = (f32)vert.y - gy1;
+			curve.x2 = floorf((curve.x1 + curve.x3) / 2.0f);
+			curve.y2 = floorf((curve.y1 + curve.y3) / 2.0f);
+			g_curves.push_back(curve);
+			curve.first = false;
+		}
+		else if(vert.type == STBTT_vmove)
+		{
+			curve.first = true;
+			curve.x3 = (f32)vert.x - gx1;
+			curve.y3 = (f32)vert.y - gy1;
 		}
 	}
 
+	AddGlyph((u32)codePoint, igx1, igy1, igx2, igy2, advanceWidth);
+
 	return true;
 }
 
-static bool ProcessFont(const char* inputPath, const char* outputPath)
+
+//
+// synthetic fonts: generated outlines for stress testing, encoded like the real ones
+//
+
+#define SYNTHETIC_UNITS_PER_EM 2048
+#define SYNTHETIC_FIRST_CODE_POINT 0x4E00 // CJK Unified Ideographs
+#define SYNTHETIC_MAX_GLYPHS 1000000
+
+// the contours are drawn in a square of this size whose bottom-left corner is at (SYNTHETIC_LEFT, SYNTHETIC_BOTTOM)
+#define SYNTHETIC_SIZE   1600.0f
+#define SYNTHETIC_LEFT   128.0f
+#define SYNTHETIC_BOTTOM -200.0f
+
+struct SyntheticSettings
 {
-	Buffer fontFile;
-	if(!ReadEntireFile(fontFile, inputPath))
+	u32 glyphCount;
+	u32 minContours; // per glyph
+	u32 maxContours;
+	u32 minCurves; // per contour
+	u32 maxCurves;
+	f32 minCurveLength; // relative lengths of the curves of a contour
+	f32 maxCurveLength;
+	f32 overlap; // [0,1]
+	u32 seed;
+};
+
+static SyntheticSettings g_synthetic = { 0, 1, 4, 4, 16, 1.0f, 4.0f, 0.0f, 1 };
+
+// xorshift32
+static u32 NextRandom(u32& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	return state;
+}
+
+// [min,max]
+static u32 RandomInt(u32& state, u32 min, u32 max)
+{
+	return min + NextRandom(state) % (max - min + 1);
+}
+
+// [min,max]
+static f32 RandomFloat(u32& state, f32 min, f32 max)
+{
+	return min + (max - min) * ((f32)(NextRandom(state) >> 8) / (f32)0xFFFFFF);
+}
+
+// every glyph gets its own sequence so that a glyph doesn't change with the glyph count
+static u32 GetGlyphSeed(u32 glyphIndex)
+{
+	u32 state = (g_synthetic.seed * 0x9E3779B9u) ^ ((glyphIndex + 1) * 0x85EBCA6Bu);
+	if(state == 0)
 	{
-		PrintError("Failed to load file into memory: %s\n", inputPath);
+		state = 1;
+	}
+
+	for(int i = 0; i < 4; ++i)
+	{
+		NextRandom(state);
+	}
+
+	return state;
+}
+
+// builds one closed contour of quadratic curves in g_curves, in font units
+// the points go around the center at a random distance, overlapping contours can wind twice
+static void AddSyntheticContour(u32& state, f32 centerX, f32 centerY, f32 radius, bool reversed, u32 windings)
+{
+	const u32 pointCount = RandomInt(state, g_synthetic.minCurves, g_synthetic.maxCurves);
+
+	// the angular spans of the curves follow the length distribution
+	std::vector<f32> spans((size_t)pointCount);
+	f32 spanSum = 0.0f;
+	for(auto& span : spans)
+	{
+		span = RandomFloat(state, g_synthetic.minCurveLength, g_synthetic.maxCurveLength);
+		spanSum += span;
+	}
+
+	const f32 twoPi = 6.283185307f;
+	const f32 angleScale = (reversed ? -twoPi : twoPi) * (f32)windings / spanSum;
+	f32 angle = RandomFloat(state, 0.0f, twoPi);
+	std::vector<f32> points;
+	for(u32 p = 0; p < pointCount; ++p)
+	{
+		// rounded like TrueType coordinates, which the loader relies on
+		const f32 r = radius * RandomFloat(state, 0.7f, 1.0f);
+		const f32 x = floorf(centerX + r * cosf(angle) + 0.5f);
+		const f32 y = floorf(centerY + r * sinf(angle) + 0.5f);
+		angle += spans[p] * angleScale;
+
+		// drop the points that rounded onto the previous one
+		const size_t n = points.size();
+		if(n == 0 || x != points[n - 2] || y != points[n - 1])
+		{
+			points.push_back(x);
+			points.push_back(y);
+		}
+	}
+
+	const size_t n = points.size();
+	if(n >= 2 && points[0] == points[n - 2] && points[1] == points[n - 1])
+	{
+		points.resize(n - 2);
+	}
+
+	const u32 curveCount = (u32)(points.size() / 2);
+	if(curveCount < 2)
+	{
+		return;
+	}
+
+	for(u32 c = 0; c < curveCount; ++c)
+	{
+		const u32 next = (c + 1) % curveCount;
+		Curve curve;
+		curve.texelIndex = 0; // assigned once the glyph gets encoded
+		curve.first = c == 0;
+		curve.x1 = points[2 * c + 0];
+		curve.y1 = points[2 * c + 1];
+		curve.x3 = points[2 * next + 0];
+		curve.y3 = points[2 * next + 1];
+
+		// bend the curve away from the segment by up to a quarter of its length
+		const f32 bend = RandomFloat(state, -0.25f, 0.25f);
+		curve.x2 = floorf((curve.x1 + curve.x3) * 0.5f - (curve.y3 - curve.y1) * bend + 0.5f);
+		curve.y2 = floorf((curve.y1 + curve.y3) * 0.5f + (curve.x3 - curve.x1) * bend + 0.5f);
+		g_curves.push_back(curve);
+	}
+}
+
+// the contours get their own grid cells, overlap moves them towards the center and grows them
+static bool ProcessSyntheticGlyph(u32 glyphIndex)
+{
+	TRACE_ZONE("ProcessSyntheticGlyph");
+
+	u32 state = GetGlyphSeed(glyphIndex);
+	const u32 contourCount = RandomInt(state, g_synthetic.minContours, g_synthetic.maxContours);
+	const u32 columns = (u32)ceilf(sqrtf((f32)contourCount));
+	const u32 rows = (contourCount + columns - 1) / columns;
+	const f32 cellW = SYNTHETIC_SIZE / (f32)columns;
+	const f32 cellH = SYNTHETIC_SIZE / (f32)rows;
+	const f32 overlap = g_synthetic.overlap;
+
+	g_curves.clear();
+	for(u32 c = 0; c < contourCount; ++c)
+	{
+		const f32 cellX = SYNTHETIC_LEFT + ((f32)(c % columns) + 0.5f) * cellW;
+		const f32 cellY = SYNTHETIC_BOTTOM + ((f32)(c / columns) + 0.5f) * cellH;
+		const f32 centerX = cellX + (SYNTHETIC_LEFT + 0.5f * SYNTHETIC_SIZE - cellX) * overlap;
+		const f32 centerY = cellY + (SYNTHETIC_BOTTOM + 0.5f * SYNTHETIC_SIZE - cellY) * overlap;
+		const f32 cellRadius = 0.45f * Min(cellW, cellH);
+		const f32 radius = cellRadius + (0.45f * SYNTHETIC_SIZE - cellRadius) * overlap;
+		const u32 windings = RandomFloat(state, 0.0f, 1.0f) < overlap ? 2 : 1;
+		AddSyntheticContour(state, centerX, centerY, radius, (c & 1) != 0, windings);
+	}
+
+	if(g_curves.empty())
+	{
+		PrintWarning("Synthetic glyph %u has no curves\n", (unsigned int)glyphIndex);
+		++g_ignoredCodePoints;
 		return false;
 	}
 
-	if(!stbtt_InitFont(&g_font, (const unsigned char*)fontFile.buffer, 0))
+	// the bounding box includes the control points, like TrueType's
+	f32 minX = g_curves[0].x1;
+	f32 minY = g_curves[0].y1;
+	f32 maxX = minX;
+	f32 maxY = minY;
+	for(const auto& c : g_curves)
 	{
-		PrintError("Failed to parse font file: %s\n", inputPath);
+		minX = Min(minX, c.x1, Min(c.x2, c.x3));
+		minY = Min(minY, c.y1, Min(c.y2, c.y3));
+		maxX = Max(maxX, c.x1, Max(c.x2, c.x3));
+		maxY = Max(maxY, c.y1, Max(c.y2, c.y3));
+	}
+
+	for(auto& c : g_curves)
+	{
+		c.x1 -= minX;
+		c.y1 -= minY;
+		c.x2 -= minX;
+		c.y2 -= minY;
+		c.x3 -= minX;
+		c.y3 -= minY;
+	}
+
+	const int igx1 = (int)minX;
+	const int igy1 = (int)minY;
+	const int igx2 = (int)maxX;
+	const int igy2 = (int)maxY;
+	AddGlyph(SYNTHETIC_FIRST_CODE_POINT + glyphIndex, igx1, igy1, igx2, igy2, igx2 + (int)SYNTHETIC_LEFT);
+
+	return true;
+}
+
+// writes the code points and textures built so far
+static bool WriteFont(const SluggishFontInfo& fontInfo, const char* inputName, const char* outputPath)
+{
+	TRACE_ZONE("WriteFont");
+
+	if(g_codePoints.empty())
+	{
+		PrintError("No valid code point found: %s\n", inputName);
 		return false;
 	}
 
@@ -339,56 +994,150 @@ static bool ProcessFont(const char* inputPath, const char* outputPath)
 		return false;
 	}
 
+	// the last curve's 2nd texel is only half used
+	if(g_curvesTexture.size() % 4 != 0)
+	{
+		g_curvesTexture.push_back(-1.0f);
+		g_curvesTexture.push_back(-1.0f);
+	}
+
+	const u32 indexedCurvesTexels = (u32)g_curvesTexture.size() / 4;
+	const u32 indexedBandsTexels = (u32)g_bandsTexture.size() / 2;
+	const u32 inlineCurvesTexels = (u32)g_inlineCurvesTexture.size() / 4;
+	const u32 inlineBandsTexels = (u32)g_inlineBandOffsets.size() / 2;
+	const u64 indexedBytes = (u64)indexedCurvesTexels * 16 + (u64)indexedBandsTexels * 4;
+	const u64 inlineBytes = (u64)inlineCurvesTexels * 16 + (u64)inlineBandsTexels * 4;
+	PrintInfo("Indexed curves: %u + %u texels, %.1f KB%s\n", (unsigned int)indexedCurvesTexels, (unsigned int)indexedBandsTexels, (f64)indexedBytes / 1024.0, g_inlineCurves ? "" : " (written)");
+	PrintInfo("Inline curves:  %u + %u texels, %.1f KB%s\n", (unsigned int)inlineCurvesTexels, (unsigned int)inlineBandsTexels, (f64)inlineBytes / 1024.0, g_inlineCurves ? " (written)" : "");
+
+	const u32 version = SLUGGISH_VERSION;
+	file.Write(SLUGGISH_HEADER_DATA, SLUGGISH_HEADER_LEN);
+	file.Write(&version, sizeof(version));
+	file.Write(&fontInfo, sizeof(fontInfo));
+
+	const u32 codePointCount = (u32)g_codePoints.size();
+	file.Write(&codePointCount, sizeof(codePointCount));
+	file.Write(&g_codePoints[0], g_codePoints.size() * sizeof(SluggishCodePoint));
+
+	if(g_inlineCurves)
+	{
+		file.Write(&inlineCurvesTexels, sizeof(inlineCurvesTexels));
+		file.Write(&g_inlineCurvesTexture[0], g_inlineCurvesTexture.size() * sizeof(g_inlineCurvesTexture[0]));
+
+		file.Write(&inlineBandsTexels, sizeof(inlineBandsTexels));
+		file.Write(&g_inlineBandOffsets[0], g_inlineBandOffsets.size() * sizeof(u16));
+	}
+	else
+	{
+		file.Write(&indexedCurvesTexels, sizeof(indexedCurvesTexels));
+		file.Write(&g_curvesTexture[0], g_curvesTexture.size() * sizeof(g_curvesTexture[0]));
+
+		file.Write(&indexedBandsTexels, sizeof(indexedBandsTexels));
+		file.Write(&g_bandsTexture[0], g_bandsTexture.size() * sizeof(u16));
+	}
+
+	if(!file.Close())
+	{
+		PrintError("Failed to write output file: %s\n", outputPath);
+		return false;
+	}
+
+	// make sure the renderers will accept what we just wrote
+	Font font;
+	if(!font.Load(outputPath, FONT_LOAD_BAND_CURVES))
+	{
+		PrintError("Generated file failed validation: %s\n", outputPath);
+		return false;
+	}
+
+	PrintInfo("'%s' -> '%s' DONE\n", inputName, outputPath);
+
+	return true;
+}
+
+static bool ProcessFont(const char* inputPath, const char* outputPath)
+{
+	TRACE_ZONE("ProcessFont");
+
+	Buffer fontFile;
+	if(!ReadEntireFile(fontFile, inputPath))
+	{
+		PrintError("Failed to load file into memory: %s\n", inputPath);
+		return false;
+	}
+
+	if(!stbtt_InitFont(&g_font, (const unsigned char*)fontFile.buffer, 0))
+	{
+		PrintError("Failed to parse font file: %s\n", inputPath);
+		return false;
+	}
+
+	int ascent, descent, lineGap;
+	stbtt_GetFontVMetrics(&g_font, &ascent, &descent, &lineGap);
+
+	SluggishFontInfo fontInfo;
+	fontInfo.ascent = (s16)ascent;
+	fontInfo.descent = (s16)descent;
+	fontInfo.lineGap = (s16)lineGap;
+	fontInfo.unitsPerEm = (u16)(1.0f / stbtt_ScaleForMappingEmToPixels(&g_font, 1.0f) + 0.5f);
+	fontInfo.flags = 0;
+	fontInfo.flags |= g_normalizedCurves ? SLUGGISH_FLAG_NORMALIZED_CURVES : 0;
+	fontInfo.flags |= g_inlineCurves ? SLUGGISH_FLAG_INLINE_CURVES : 0;
+	g_autotune.unitsPerEm = fontInfo.unitsPerEm;
+
 	for(int i = 33; i <= 126; ++i)
 	{
 		ProcessCodePoint(i);
 	}
+	EncodeAutotunedGlyphs();
 
-	if(g_codePoints.empty())
+	if(!WriteFont(fontInfo, inputPath, outputPath))
 	{
-		PrintError("No valid code point found: %s\n", inputPath);
 		return false;
 	}
 
-	// fix up the bands' texel offsets first
-	const u32 bandsTexTexels = (u32)(g_bandsTextureBandOffsets.size() + g_bandsTextureCurveOffsets.size()) / 2;
-	const u16 bandHeaderTexels = (u16)(g_bandsTextureBandOffsets.size() / 2);
-	for(size_t i = 1; i < g_bandsTextureBandOffsets.size(); i += 2)
+	PrintInfo("Code points ignored: %u\n", (unsigned int)g_ignoredCodePoints);
+
+	return true;
+}
+
+static bool ProcessSyntheticFont(const char* outputPath)
+{
+	TRACE_ZONE("ProcessSyntheticFont");
+
+	SluggishFontInfo fontInfo;
+	fontInfo.ascent = (s16)(SYNTHETIC_UNITS_PER_EM * 4 / 5);
+	fontInfo.descent = (s16)-(SYNTHETIC_UNITS_PER_EM / 5);
+	fontInfo.lineGap = 0;
+	fontInfo.unitsPerEm = (u16)SYNTHETIC_UNITS_PER_EM;
+	fontInfo.flags = 0;
+	fontInfo.flags |= g_normalizedCurves ? SLUGGISH_FLAG_NORMALIZED_CURVES : 0;
+	fontInfo.flags |= g_inlineCurves ? SLUGGISH_FLAG_INLINE_CURVES : 0;
+	g_autotune.unitsPerEm = fontInfo.unitsPerEm;
+
+	u64 curveCount = 0;
+	u32 maxCurveCount = 0;
+	for(u32 i = 0; i < g_synthetic.glyphCount; ++i)
 	{
-		g_bandsTextureBandOffsets[i] += bandHeaderTexels;
-		if(g_bandsTextureBandOffsets[i] >= bandsTexTexels)
+		if(ProcessSyntheticGlyph(i))
 		{
-			FatalError("Too much data generated to be indexed! Try a lower band count.\n");
+			curveCount += (u64)g_curves.size();
+			maxCurveCount = Max(maxCurveCount, (u32)g_curves.size());
 		}
 	}
+	EncodeAutotunedGlyphs();
 
-	file.Write(SLUGGISH_HEADER_DATA, SLUGGISH_HEADER_LEN);
-
-	const u16 codePointCount = (u16)g_codePoints.size();
-	file.Write(&codePointCount, sizeof(codePointCount));
-	file.Write(&g_codePoints[0], g_codePoints.size() * sizeof(SluggishCodePoint));
+	if(!WriteFont(fontInfo, "synthetic", outputPath))
+	{
+		return false;
+	}
 
-	const u16 curvesTexWidth = TEXTURE_WIDTH;
-	const u32 curvesTexTexels = (u32)g_curvesTexture.size() / 4;
-	const u32 curvesTexBytes = (u32)g_curvesTexture.size() * (u32)sizeof(g_curvesTexture[0]);
-	const u16 curvesTexHeight = (u16)((curvesTexTexels + curvesTexWidth - 1) / curvesTexWidth);
-	file.Write(&curvesTexWidth, sizeof(curvesTexWidth));
-	file.Write(&curvesTexHeight, sizeof(curvesTexHeight));
-	file.Write(&curvesTexBytes, sizeof(curvesTexBytes));
-	file.Write(&g_curvesTexture[0], curvesTexBytes);
-
-	const u16 bandsTexWidth = TEXTURE_WIDTH;
-	
-	const u32 bandsTexBytes = bandsTexTexels * (u32)sizeof(u16) * 2;
-	const u16 bandsTexHeight = (u16)((bandsTexTexels + bandsTexWidth - 1) / bandsTexWidth);
-	file.Write(&bandsTexWidth, sizeof(bandsTexWidth));
-	file.Write(&bandsTexHeight, sizeof(bandsTexHeight));
-	file.Write(&bandsTexBytes, sizeof(bandsTexBytes));
-	file.Write(&g_bandsTextureBandOffsets[0], g_bandsTextureBandOffsets.size() * sizeof(u16));
-	file.Write(&g_bandsTextureCurveOffsets[0], g_bandsTextureCurveOffsets.size() * sizeof(u16));
-
-	PrintInfo("'%s' -> '%s' DONE\n", inputPath, outputPath);
-	PrintInfo("Code points ignored: %u\n", (unsigned int)g_ignoredCodePoints);
+	const u32 glyphCount = (u32)g_codePoints.size();
+	PrintInfo("Synthetic glyphs: %u (U+%04X to U+%04X)\n", (unsigned int)glyphCount,
+			  (unsigned int)SYNTHETIC_FIRST_CODE_POINT, (unsigned int)g_codePoints[glyphCount - 1].codePoint);
+	PrintInfo("Curves: %llu, %.1f per glyph on average, %u max.\n",
+			  (unsigned long long)curveCount, (f64)curveCount / (f64)glyphCount, (unsigned int)maxCurveCount);
+	PrintInfo("Glyphs ignored: %u\n", (unsigned int)g_ignoredCodePoints);
 
 	return true;
 }
@@ -400,14 +1149,42 @@ int main(int argc, char** argv)
 		printf("Reads a TrueType font file and outputs a Sluggish font file.\n");
 		printf("The output %s file will be in the same directory as the input.\n", SLUGGISH_EXTENSION_NAME);
 		printf("\n");
-		printf("%s <input.ttf> [-bands=x,y]\n", GetExecutableFileName(argv[0]));
+		printf("%s <input.ttf> [-bands=x,y] [-normalized] [-inline] [-autotune=sizes] [-budget=x]\n", GetExecutableFileName(argv[0]));
+		printf("         [-trace=file.json]\n");
+		printf("%s <output_name> -synthetic=glyphs [-contours=min,max] [-curves=min,max]\n", GetExecutableFileName(argv[0]));
+		printf("         [-curvelength=min,max] [-overlap=x] [-seed=n] [-bands=x,y] [-normalized] [-inline]\n");
+		printf("         [-autotune=sizes] [-budget=x] [-trace=file.json]\n");
 		printf("\n");
-		printf("bands  The maximum number of horizontal and vertical bands that\n");
-		printf("       each glyph will be split into.\n");
-		printf("       By default, this number is 16. Allowed range: [1,32].\n");
+		printf("bands       The maximum number of horizontal and vertical bands that\n");
+		printf("            each glyph will be split into.\n");
+		printf("            By default, this number is 16. Allowed range: [1,32].\n");
+		printf("normalized  Store the curves in the glyph's unit box instead of font units.\n");
+		printf("            The renderers can use either, this only saves some work at load time.\n");
+		printf("inline      Store each band's curves contiguously instead of indexing them.\n");
+		printf("            Uses more memory but saves the shader a dependent fetch per curve.\n");
+		printf("            The sizes of both layouts get printed either way.\n");
+		printf("autotune    Pick each glyph's band count by timing the CPU rasterizer with 1 to 32 bands\n");
+		printf("            at up to %d sizes in pixels per em, e.g. 16,32,64. The timings vary\n", AUTOTUNE_MAX_SIZES);
+		printf("            from run to run, so the output can too.\n");
+		printf("budget      The max. size of the band and curve data in autotune mode, relative to\n");
+		printf("            encoding every glyph with the -bands count. By default: 1.\n");
+		printf("synthetic   Generate this many random glyphs instead of reading a font,\n");
+		printf("            starting at U+%04X. The output is <output_name>%s.\n", SYNTHETIC_FIRST_CODE_POINT, SLUGGISH_EXTENSION_NAME);
+		printf("            Allowed range: [1,%u].\n", SYNTHETIC_MAX_GLYPHS);
+		printf("contours    The number of contours per synthetic glyph. By default: 1,4.\n");
+		printf("curves      The number of curves per contour. By default: 4,16.\n");
+		printf("curvelength The relative length range of a contour's curves.\n");
+		printf("            1,1 makes curves of equal length. By default: 1,4.\n");
+		printf("overlap     0 keeps the contours apart, 1 stacks them on top of each other.\n");
+		printf("            It's also the odds of a contour overlapping itself. By default: 0.\n");
+		printf("seed        The same seed always generates the same glyphs. By default: 1.\n");
+		printf("trace       Write the timings of the processing steps to a Chrome trace file\n");
+		printf("            (chrome://tracing or ui.perfetto.dev).\n");
+		printf("            Only in the debug builds or when premake got the --trace option.\n");
 		return 1337;
 	}
 
+	char tracePath[512] = { 0 };
 	for(int i = 2; i < argc; ++i)
 	{
 		const char* const arg = argv[i];
@@ -419,6 +1196,97 @@ int main(int argc, char** argv)
 				g_bandCount = (u32)s;
 			}
 		}
+		else if(strcmp(arg, "-normalized") == 0)
+		{
+			g_normalizedCurves = true;
+		}
+		else if(strcmp(arg, "-inline") == 0)
+		{
+			g_inlineCurves = true;
+		}
+		else if(strstr(arg, "-autotune=") == arg)
+		{
+			u32 sizes[AUTOTUNE_MAX_SIZES];
+			const int n = sscanf(arg, "-autotune=%u,%u,%u,%u", &sizes[0], &sizes[1], &sizes[2], &sizes[3]);
+			bool valid = n >= 1;
+			for(int s = 0; s < n; ++s)
+			{
+				valid &= sizes[s] >= 4 && sizes[s] <= 1024;
+			}
+			if(valid)
+			{
+				g_autotune.sizeCount = (u32)n;
+				memcpy(g_autotune.pixelsPerEm, sizes, sizeof(sizes));
+			}
+		}
+		else if(strstr(arg, "-budget=") == arg)
+		{
+			f32 x;
+			if(sscanf(arg, "-budget=%f", &x) == 1 && x > 0.0f)
+			{
+				g_autotune.budget = x;
+			}
+		}
+		else if(strstr(arg, "-synthetic=") == arg)
+		{
+			u32 n;
+			if(sscanf(arg, "-synthetic=%u", &n) == 1 && n >= 1 && n <= SYNTHETIC_MAX_GLYPHS)
+			{
+				g_synthetic.glyphCount = n;
+			}
+		}
+		else if(strstr(arg, "-contours=") == arg)
+		{
+			u32 a, b;
+			if(sscanf(arg, "-contours=%u,%u", &a, &b) == 2 && a >= 1 && a <= b)
+			{
+				g_synthetic.minContours = a;
+				g_synthetic.maxContours = b;
+			}
+		}
+		else if(strstr(arg, "-curves=") == arg)
+		{
+			u32 a, b;
+			if(sscanf(arg, "-curves=%u,%u", &a, &b) == 2 && a >= 2 && a <= b)
+			{
+				g_synthetic.minCurves = a;
+				g_synthetic.maxCurves = b;
+			}
+		}
+		else if(strstr(arg, "-curvelength=") == arg)
+		{
+			f32 a, b;
+			if(sscanf(arg, "-curvelength=%f,%f", &a, &b) == 2 && a > 0.0f && a <= b)
+			{
+				g_synthetic.minCurveLength = a;
+				g_synthetic.maxCurveLength = b;
+			}
+		}
+		else if(strstr(arg, "-overlap=") == arg)
+		{
+			f32 x;
+			if(sscanf(arg, "-overlap=%f", &x) == 1)
+			{
+				g_synthetic.overlap = Clamp(x, 0.0f, 1.0f);
+			}
+		}
+		else if(strstr(arg, "-seed=") == arg)
+		{
+			u32 n;
+			if(sscanf(arg, "-seed=%u", &n) == 1)
+			{
+				g_synthetic.seed = n;
+			}
+		}
+		else if(strstr(arg, "-trace=") == arg)
+		{
+			sscanf(arg, "-trace=%511s", tracePath);
+		}
+	}
+
+	if(tracePath[0] != '\0')
+	{
+		Trace_Open(tracePath);
 	}
 
 	const char* inputPath = argv[1];
@@ -431,5 +1299,8 @@ int main(int argc, char** argv)
 	}
 	strcat(outputPath, SLUGGISH_EXTENSION_NAME);
 
-	return ProcessFont(inputPath, outputPath) ? 0 : 1;
+	const bool success = g_synthetic.glyphCount > 0 ? ProcessSyntheticFont(outputPath) : ProcessFont(inputPath, outputPath);
+	Trace_Close();
+
+	return success ? 0 : 1;
 }
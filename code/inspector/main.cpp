@@ -0,0 +1,618 @@
+#include "../sluggish/font.hpp"
+#include "../shared.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+#define INSPECT_RESULTS_VERSION 1
+
+// SLUGGISH_HEADER_DATA + version + SluggishFontInfo + code point count
+#define FILE_HEADER_BYTES (SLUGGISH_HEADER_LEN + 4 + sizeof(SluggishFontInfo) + 4)
+
+/*
+Results file format (.json)
+
+{
+	"inspector": "fontinspect",
+	"version": 1,
+	"input": "<path>",
+	"font": { ... },
+	"sections": { ... },
+	"curves_texture": { ... },
+	"summary": { ... },
+	"most_expensive": [ <code point>, ... ],
+	"glyphs":
+	[
+		{ "code_point": <n>, "curves": <n>, "bands": <n>, ... },
+		...
+	]
+}
+
+The estimates assume the pixels are spread uniformly over the glyph's bounding box.
+tested_per_pixel: curves tested by the 2 rays of the CPU rasterizer, which stops at the first curve left of the pixel
+band_per_pixel: curves of the 2 bands the pixel is in, which the shader tests all of
+*/
+
+struct GlyphStats
+{
+	u32 codePoint;
+	u32 width;
+	u32 height;
+	u32 curveCount; // distinct curves
+	u32 bandCount; // per direction
+	u32 bandDimX;
+	u32 bandDimY;
+	u32 minBandCurves;
+	u32 maxBandCurves;
+	u32 bandCurveSum; // all the band lists' entries
+	u32 duplicateBands; // same curves as another band of the same direction
+	u32 bandsBytes; // headers and, with the indexed layout, curve lists
+	u32 curvesBytes; // the glyph's range of the curves texture
+	f32 testedPerPixel;
+	f32 bandPerPixel;
+	f64 testsPerGlyph; // testedPerPixel * the glyph's pixels at the selected size
+};
+
+// the textures as stored in the file
+// Font::Load converts the curves, padding included, when they're not in the units it needs
+struct FileTextures
+{
+	const f32* curves;
+	u32 curvesTexels;
+	const u16* bands;
+	u32 bandsTexels;
+};
+
+struct CurvesTextureStats
+{
+	u64 floatCount;
+	u64 usedFloats; // read by at least one band
+	u64 paddingFloats; // the -1.0f fill aligning contours and the last texel
+	u64 otherUnusedFloats; // the inline layout's half-empty texels, curves no band references
+};
+
+// a curve's control points, in glyph space
+struct InspectCurve
+{
+	f32 p[6];
+
+	bool operator<(const InspectCurve& other) const
+	{
+		return std::lexicographical_compare(p, p + 6, other.p, other.p + 6);
+	}
+
+	bool operator==(const InspectCurve& other) const
+	{
+		return std::equal(p, p + 6, other.p);
+	}
+};
+
+struct FontStats
+{
+	u64 codePointsBytes;
+	u64 curvesBytes;
+	u64 bandsBytes;
+	u64 bandHeadersBytes;
+	u64 curveListsBytes; // indexed layout only
+	u64 fileBytes;
+	u64 totalBands;
+	u64 totalBandCurves;
+	u64 duplicateBands;
+	u32 minBandCurves;
+	u32 maxBandCurves;
+	f64 testedPerPixel; // weighted by the glyphs' areas
+	f64 bandPerPixel; // weighted by the glyphs' areas
+	CurvesTextureStats curves;
+};
+
+
+// the curves of the band in ray space, i.e. x and y are swapped for vertical bands
+static bool SameBandCurves(const FontBandCurves& curves, const FontBandSpan& a, const FontBandSpan& b)
+{
+	if(a.curveCount != b.curveCount)
+	{
+		return false;
+	}
+
+	const f32* const arrays[6] = { curves.x1, curves.y1, curves.x2, curves.y2, curves.x3, curves.y3 };
+	for(int i = 0; i < 6; ++i)
+	{
+		if(memcmp(arrays[i] + a.firstCurve, arrays[i] + b.firstCurve, (size_t)a.curveCount * sizeof(f32)) != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// the expected number of curves a ray tests in the band when it starts anywhere in [0, extent]
+// the curves are sorted by decreasing maxX and the loop stops at the first one entirely on the left
+static f32 GetExpectedCurvesTested(const FontBandCurves& curves, const FontBandSpan& band, f32 extent)
+{
+	if(band.curveCount == 0)
+	{
+		return 0.0f;
+	}
+
+	const f32* const maxX = curves.maxX + band.firstCurve;
+	f32 tested = 0.0f;
+	for(u32 c = 0; c < band.curveCount; ++c)
+	{
+		tested += Clamp(maxX[c] / extent, 0.0f, 1.0f);
+	}
+
+	// the curve we stop at gets tested too
+	tested += 1.0f - Clamp(maxX[band.curveCount - 1] / extent, 0.0f, 1.0f);
+
+	return tested;
+}
+
+// the fraction of the glyph's extent covered by band b
+static f32 GetBandWeight(u32 b, u32 bandDim, u32 extent)
+{
+	const u32 first = b * bandDim;
+	if(first >= extent)
+	{
+		return 0.0f;
+	}
+
+	return (f32)Min(bandDim, extent - first) / (f32)extent;
+}
+
+static void InspectGlyph(GlyphStats& g, const Font& font, const FileTextures& textures, const SluggishCodePoint& cp, bool inlineCurves, f32 pixelsPerEm)
+{
+	const FontBandCurves& curves = font.bandCurves;
+	const u32 n = cp.bandCount;
+	const u32 extentX = Max(cp.width, 1u);
+	const u32 extentY = Max(cp.height, 1u);
+
+	g.codePoint = cp.codePoint;
+	g.width = cp.width;
+	g.height = cp.height;
+	g.bandCount = n;
+	g.bandDimX = cp.bandDimX;
+	g.bandDimY = cp.bandDimY;
+	g.minBandCurves = n > 0 ? 0xFFFFFFFF : 0;
+	g.maxBandCurves = 0;
+	g.bandCurveSum = 0;
+	g.duplicateBands = 0;
+	g.testedPerPixel = 0.0f;
+	g.bandPerPixel = 0.0f;
+
+	// distinct curves, back in glyph space
+	std::vector<InspectCurve> distinct;
+	for(u32 b = 0; b < 2 * n; ++b)
+	{
+		const bool vertical = b >= n;
+		const FontBandSpan& band = curves.bands[cp.bandsTexelIndex + b];
+		g.minBandCurves = Min(g.minBandCurves, band.curveCount);
+		g.maxBandCurves = Max(g.maxBandCurves, band.curveCount);
+		g.bandCurveSum += band.curveCount;
+
+		const u32 firstSameDirection = vertical ? n : 0;
+		for(u32 o = firstSameDirection; o < b; ++o)
+		{
+			if(SameBandCurves(curves, band, curves.bands[cp.bandsTexelIndex + o]))
+			{
+				++g.duplicateBands;
+				break;
+			}
+		}
+
+		const f32 weight = vertical ? GetBandWeight(b - n, cp.bandDimX, extentX) : GetBandWeight(b, cp.bandDimY, extentY);
+		g.bandPerPixel += weight * (f32)band.curveCount;
+		g.testedPerPixel += weight * GetExpectedCurvesTested(curves, band, (f32)(vertical ? extentY : extentX));
+
+		for(u32 c = band.firstCurve; c < band.firstCurve + band.curveCount; ++c)
+		{
+			InspectCurve curve;
+			curve.p[0] = vertical ? curves.y1[c] : curves.x1[c];
+			curve.p[1] = vertical ? curves.x1[c] : curves.y1[c];
+			curve.p[2] = vertical ? curves.y2[c] : curves.x2[c];
+			curve.p[3] = vertical ? curves.x2[c] : curves.y2[c];
+			curve.p[4] = vertical ? curves.y3[c] : curves.x3[c];
+			curve.p[5] = vertical ? curves.x3[c] : curves.y3[c];
+			distinct.push_back(curve);
+		}
+	}
+	std::sort(std::begin(distinct), std::end(distinct));
+	g.curveCount = (u32)(std::unique(std::begin(distinct), std::end(distinct)) - std::begin(distinct));
+
+	if(inlineCurves)
+	{
+		// 2 texels per band entry
+		g.bandsBytes = 2 * n * 4;
+		g.curvesBytes = g.bandCurveSum * 2 * 16;
+	}
+	else
+	{
+		g.bandsBytes = (2 * n + g.bandCurveSum) * 4;
+		u32 firstTexel = 0xFFFFFFFF;
+		u32 lastTexel = 0;
+		for(u32 b = 0; b < 2 * n; ++b)
+		{
+			const u16* const header = &textures.bands[2 * (cp.bandsTexelIndex + b)];
+			for(u32 c = 0; c < (u32)header[0]; ++c)
+			{
+				const u16* const ref = &textures.bands[2 * (cp.bandsTexelIndex + (u32)header[1] + c)];
+				const u32 texel = (u32)ref[0] | ((u32)ref[1] << 16);
+				firstTexel = Min(firstTexel, texel);
+				lastTexel = Max(lastTexel, texel + 1);
+			}
+		}
+		g.curvesBytes = firstTexel != 0xFFFFFFFF ? (lastTexel - firstTexel + 1) * 16 : 0;
+	}
+
+	// the pixels of the glyph's box at that size, like an atlas entry
+	const f32 pixelsPerUnit = pixelsPerEm / (f32)font.info.unitsPerEm;
+	const f64 pixelCount = (f64)(ceilf((f32)cp.width * pixelsPerUnit) + 1.0f) * (f64)(ceilf((f32)cp.height * pixelsPerUnit) + 1.0f);
+	g.testsPerGlyph = (f64)g.testedPerPixel * pixelCount;
+}
+
+static void InspectCurvesTexture(CurvesTextureStats& s, const Font& font, const FileTextures& textures, bool inlineCurves)
+{
+	const size_t floatCount = 4 * (size_t)textures.curvesTexels;
+	std::vector<u8> used(floatCount, 0);
+	for(const auto& cp : font.codePoints)
+	{
+		for(u32 b = 0; b < 2 * cp.bandCount; ++b)
+		{
+			const u16* const header = &textures.bands[2 * (cp.bandsTexelIndex + b)];
+			for(u32 c = 0; c < (u32)header[0]; ++c)
+			{
+				u32 texel;
+				if(inlineCurves)
+				{
+					texel = cp.curvesTexelIndex + (u32)header[1] + 2 * c;
+				}
+				else
+				{
+					const u16* const ref = &textures.bands[2 * (cp.bandsTexelIndex + (u32)header[1] + c)];
+					texel = (u32)ref[0] | ((u32)ref[1] << 16);
+				}
+
+				// [x1 y1 x2 y2] [x3 y3]
+				memset(&used[4 * (size_t)texel], 1, 6);
+			}
+		}
+	}
+
+	s.floatCount = (u64)floatCount;
+	s.usedFloats = 0;
+	s.paddingFloats = 0;
+	s.otherUnusedFloats = 0;
+	for(size_t i = 0; i < floatCount; ++i)
+	{
+		if(used[i])
+		{
+			++s.usedFloats;
+		}
+		else if(textures.curves[i] == -1.0f)
+		{
+			++s.paddingFloats;
+		}
+		else
+		{
+			++s.otherUnusedFloats;
+		}
+	}
+}
+
+static void InspectFont(FontStats& s, std::vector<GlyphStats>& glyphs, const Font& font, const FileTextures& textures, f32 pixelsPerEm, u64 fileBytes)
+{
+	const bool inlineCurves = (font.info.flags & SLUGGISH_FLAG_INLINE_CURVES) != 0;
+
+	s.codePointsBytes = (u64)font.codePoints.size() * sizeof(SluggishCodePoint);
+	s.curvesBytes = (u64)textures.curvesTexels * 16;
+	s.bandsBytes = (u64)textures.bandsTexels * 4;
+	s.bandHeadersBytes = 0;
+	s.fileBytes = fileBytes;
+	s.totalBands = 0;
+	s.totalBandCurves = 0;
+	s.duplicateBands = 0;
+	s.minBandCurves = 0xFFFFFFFF;
+	s.maxBandCurves = 0;
+	s.testedPerPixel = 0.0;
+	s.bandPerPixel = 0.0;
+
+	f64 totalArea = 0.0;
+	glyphs.resize(font.codePoints.size());
+	for(size_t i = 0; i < font.codePoints.size(); ++i)
+	{
+		const SluggishCodePoint& cp = font.codePoints[i];
+		GlyphStats& g = glyphs[i];
+		InspectGlyph(g, font, textures, cp, inlineCurves, pixelsPerEm);
+
+		s.bandHeadersBytes += (u64)(2 * cp.bandCount * 4);
+		s.totalBands += (u64)(2 * cp.bandCount);
+		s.totalBandCurves += (u64)g.bandCurveSum;
+		s.duplicateBands += (u64)g.duplicateBands;
+		if(cp.bandCount > 0)
+		{
+			s.minBandCurves = Min(s.minBandCurves, g.minBandCurves);
+			s.maxBandCurves = Max(s.maxBandCurves, g.maxBandCurves);
+		}
+
+		const f64 area = (f64)cp.width * (f64)cp.height;
+		s.testedPerPixel += area * (f64)g.testedPerPixel;
+		s.bandPerPixel += area * (f64)g.bandPerPixel;
+		totalArea += area;
+	}
+
+	if(s.totalBands == 0)
+	{
+		s.minBandCurves = 0;
+	}
+
+	if(totalArea > 0.0)
+	{
+		s.testedPerPixel /= totalArea;
+		s.bandPerPixel /= totalArea;
+	}
+
+	s.curveListsBytes = inlineCurves ? 0 : s.bandsBytes - s.bandHeadersBytes;
+	InspectCurvesTexture(s.curves, font, textures, inlineCurves);
+}
+
+static f64 Percent(u64 part, u64 total)
+{
+	return total > 0 ? (100.0 * (f64)part / (f64)total) : 0.0;
+}
+
+static void PrintGlyphHeader()
+{
+	PrintInfo("%-9s %6s %5s %9s %5s %6s %5s %5s %7s %8s %11s\n",
+			  "glyph", "curves", "bands", "band dims", "min", "mean", "max", "dupes", "tested", "in bands", "tests/glyph");
+}
+
+static void PrintGlyph(const GlyphStats& g)
+{
+	char name[16];
+	char dims[32];
+	sprintf(name, "U+%04X", g.codePoint);
+	sprintf(dims, "%ux%u", g.bandDimX, g.bandDimY);
+	const f32 meanBandCurves = g.bandCount > 0 ? (f32)g.bandCurveSum / (f32)(2 * g.bandCount) : 0.0f;
+	PrintInfo("%-9s %6u %5u %9s %5u %6.1f %5u %5u %7.2f %8.2f %11.0f\n",
+			  name, g.curveCount, g.bandCount, dims, g.minBandCurves, meanBandCurves, g.maxBandCurves, g.duplicateBands, g.testedPerPixel, g.bandPerPixel, g.testsPerGlyph);
+}
+
+static void PrintReport(const Font& font, const FontStats& s, const std::vector<GlyphStats>& glyphs, const std::vector<u32>& top, f32 pixelsPerEm, bool printGlyphs)
+{
+	const bool inlineCurves = (font.info.flags & SLUGGISH_FLAG_INLINE_CURVES) != 0;
+	const u32 glyphCount = (u32)glyphs.size();
+	u64 curveCount = 0;
+	u32 maxCurveCount = 0;
+	for(const auto& g : glyphs)
+	{
+		curveCount += (u64)g.curveCount;
+		maxCurveCount = Max(maxCurveCount, g.curveCount);
+	}
+
+	PrintInfo("Font: %u glyphs, %u units per em, %s layout, curves in %s\n", glyphCount, (unsigned int)font.info.unitsPerEm,
+			  inlineCurves ? "inline" : "indexed", (font.info.flags & SLUGGISH_FLAG_NORMALIZED_CURVES) != 0 ? "the unit box" : "font units");
+
+	PrintInfo("\nSections (bytes)\n");
+	PrintInfo("  header       %10llu\n", (unsigned long long)FILE_HEADER_BYTES);
+	PrintInfo("  code points  %10llu  %5.1f%%\n", (unsigned long long)s.codePointsBytes, Percent(s.codePointsBytes, s.fileBytes));
+	PrintInfo("  curves       %10llu  %5.1f%%\n", (unsigned long long)s.curvesBytes + 4, Percent(s.curvesBytes + 4, s.fileBytes));
+	PrintInfo("  bands        %10llu  %5.1f%%  (headers: %llu, curve lists: %llu)\n", (unsigned long long)s.bandsBytes + 4, Percent(s.bandsBytes + 4, s.fileBytes),
+			  (unsigned long long)s.bandHeadersBytes, (unsigned long long)s.curveListsBytes);
+	PrintInfo("  file         %10llu\n", (unsigned long long)s.fileBytes);
+
+	const CurvesTextureStats& c = s.curves;
+	PrintInfo("\nCurves texture (floats)\n");
+	PrintInfo("  used         %10llu  %5.1f%%\n", (unsigned long long)c.usedFloats, Percent(c.usedFloats, c.floatCount));
+	PrintInfo("  padding      %10llu  %5.1f%%  (-1.0f fill)\n", (unsigned long long)c.paddingFloats, Percent(c.paddingFloats, c.floatCount));
+	PrintInfo("  other unused %10llu  %5.1f%%  (%s)\n", (unsigned long long)c.otherUnusedFloats, Percent(c.otherUnusedFloats, c.floatCount),
+			  inlineCurves ? "half-empty 2nd texels" : "curves no band references");
+
+	PrintInfo("\nBands\n");
+	PrintInfo("  bands        %10llu\n", (unsigned long long)s.totalBands);
+	PrintInfo("  curves/band  %10u min, %.2f mean, %u max\n", s.minBandCurves,
+			  s.totalBands > 0 ? (f64)s.totalBandCurves / (f64)s.totalBands : 0.0, s.maxBandCurves);
+	PrintInfo("  duplicates   %10llu  %5.1f%%  (same curves as another band of the glyph)\n", (unsigned long long)s.duplicateBands, Percent(s.duplicateBands, s.totalBands));
+	PrintInfo("  curves/glyph %10.1f mean, %u max (distinct)\n", glyphCount > 0 ? (f64)curveCount / (f64)glyphCount : 0.0, maxCurveCount);
+
+	PrintInfo("\nCurves tested per pixel (2 rays, weighted by glyph area)\n");
+	PrintInfo("  CPU          %10.2f  (stops at the first curve on the left)\n", s.testedPerPixel);
+	PrintInfo("  GPU          %10.2f  (all the curves of both bands)\n", s.bandPerPixel);
+
+	if(!top.empty())
+	{
+		PrintInfo("\nMost expensive glyphs at %g pixels per em\n", pixelsPerEm);
+		PrintGlyphHeader();
+		for(u32 i : top)
+		{
+			PrintGlyph(glyphs[i]);
+		}
+	}
+
+	if(printGlyphs)
+	{
+		PrintInfo("\nAll glyphs at %g pixels per em\n", pixelsPerEm);
+		PrintGlyphHeader();
+		for(const auto& g : glyphs)
+		{
+			PrintGlyph(g);
+		}
+	}
+}
+
+static bool WriteResults(const char* outputPath, const char* inputPath, const Font& font, const FontStats& s, const std::vector<GlyphStats>& glyphs, const std::vector<u32>& top, f32 pixelsPerEm)
+{
+	FILE* const file = fopen(outputPath, "w");
+	if(file == NULL)
+	{
+		PrintError("Failed to open output file: %s\n", outputPath);
+		return false;
+	}
+
+	// JSON strings can't hold raw backslashes
+	std::string input = inputPath;
+	std::replace(input.begin(), input.end(), '\\', '/');
+
+	const CurvesTextureStats& c = s.curves;
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"inspector\": \"fontinspect\",\n");
+	fprintf(file, "\t\"version\": %d,\n", INSPECT_RESULTS_VERSION);
+	fprintf(file, "\t\"input\": \"%s\",\n", input.c_str());
+	fprintf(file, "\t\"font\": { \"glyphs\": %u, \"units_per_em\": %u, \"layout\": \"%s\", \"normalized\": %s, \"pixels_per_em\": %g },\n",
+			(unsigned int)glyphs.size(), (unsigned int)font.info.unitsPerEm, (font.info.flags & SLUGGISH_FLAG_INLINE_CURVES) != 0 ? "inline" : "indexed",
+			(font.info.flags & SLUGGISH_FLAG_NORMALIZED_CURVES) != 0 ? "true" : "false", pixelsPerEm);
+	fprintf(file, "\t\"sections\": { \"header\": %u, \"code_points\": %llu, \"curves\": %llu, \"bands\": %llu, \"band_headers\": %llu, \"curve_lists\": %llu, \"file\": %llu },\n",
+			(unsigned int)FILE_HEADER_BYTES, (unsigned long long)s.codePointsBytes, (unsigned long long)s.curvesBytes + 4, (unsigned long long)s.bandsBytes + 4,
+			(unsigned long long)s.bandHeadersBytes, (unsigned long long)s.curveListsBytes, (unsigned long long)s.fileBytes);
+	fprintf(file, "\t\"curves_texture\": { \"floats\": %llu, \"used\": %llu, \"padding\": %llu, \"other_unused\": %llu },\n",
+			(unsigned long long)c.floatCount, (unsigned long long)c.usedFloats, (unsigned long long)c.paddingFloats, (unsigned long long)c.otherUnusedFloats);
+	fprintf(file, "\t\"summary\": { \"bands\": %llu, \"band_curves\": %llu, \"min_band_curves\": %u, \"max_band_curves\": %u, \"duplicate_bands\": %llu, \"duplicate_band_ratio\": %.4f, \"tested_per_pixel\": %.4f, \"band_per_pixel\": %.4f },\n",
+			(unsigned long long)s.totalBands, (unsigned long long)s.totalBandCurves, s.minBandCurves, s.maxBandCurves,
+			(unsigned long long)s.duplicateBands, s.totalBands > 0 ? (f64)s.duplicateBands / (f64)s.totalBands : 0.0, s.testedPerPixel, s.bandPerPixel);
+	fprintf(file, "\t\"most_expensive\": [");
+	for(size_t i = 0; i < top.size(); ++i)
+	{
+		fprintf(file, "%s%u", i > 0 ? ", " : " ", glyphs[top[i]].codePoint);
+	}
+	fprintf(file, "%s],\n", top.empty() ? "" : " ");
+	fprintf(file, "\t\"glyphs\":\n");
+	fprintf(file, "\t[\n");
+	for(size_t i = 0; i < glyphs.size(); ++i)
+	{
+		const GlyphStats& g = glyphs[i];
+		fprintf(file, "\t\t{ \"code_point\": %u, \"width\": %u, \"height\": %u, \"curves\": %u, \"bands\": %u, \"band_dim_x\": %u, \"band_dim_y\": %u, "
+				"\"min_band_curves\": %u, \"mean_band_curves\": %.3f, \"max_band_curves\": %u, \"duplicate_bands\": %u, \"bands_bytes\": %u, \"curves_bytes\": %u, "
+				"\"tested_per_pixel\": %.4f, \"band_per_pixel\": %.4f, \"tests_per_glyph\": %.0f }%s\n",
+				g.codePoint, g.width, g.height, g.curveCount, g.bandCount, g.bandDimX, g.bandDimY,
+				g.minBandCurves, g.bandCount > 0 ? (f64)g.bandCurveSum / (f64)(2 * g.bandCount) : 0.0, g.maxBandCurves, g.duplicateBands, g.bandsBytes, g.curvesBytes,
+				g.testedPerPixel, g.bandPerPixel, g.testsPerGlyph, i + 1 < glyphs.size() ? "," : "");
+	}
+	fprintf(file, "\t]\n");
+	fprintf(file, "}\n");
+
+	const bool success = ferror(file) == 0;
+	fclose(file);
+	if(!success)
+	{
+		PrintError("Failed to write output file: %s\n", outputPath);
+	}
+
+	return success;
+}
+
+int main(int argc, char** argv)
+{
+	if(ShouldPrintHelp(argc, argv))
+	{
+		printf("Reports what a Sluggish font file is made of and where the rendering time goes.\n");
+		printf("\n");
+		printf("%s <input%s> [-top=count] [-ppem=pixels_per_em] [-glyphs] [-json=path]\n", GetExecutableFileName(argv[0]), SLUGGISH_EXTENSION_NAME);
+		printf("\n");
+		printf("top      The number of most expensive glyphs to list.\n");
+		printf("         By default, 10 glyphs are listed.\n");
+		printf("ppem     The size used to rank the glyphs: the cost of a glyph is\n");
+		printf("         the curves tested per pixel times its pixels at that size.\n");
+		printf("         By default, it's 32 pixels per em.\n");
+		printf("glyphs   Also lists every glyph.\n");
+		printf("json     Also writes the report and every glyph's stats to a JSON file.\n");
+		printf("\n");
+		printf("The curves tested per pixel are estimated for pixels spread uniformly\n");
+		printf("over the glyph's bounding box, with a horizontal and a vertical ray.\n");
+		return 1337;
+	}
+
+	u32 topCount = 10;
+	f32 pixelsPerEm = 32.0f;
+	bool printGlyphs = false;
+	const char* jsonPath = NULL;
+	for(int i = 2; i < argc; ++i)
+	{
+		const char* const arg = argv[i];
+		if(strstr(arg, "-top=") == arg)
+		{
+			u32 n;
+			if(sscanf(arg, "-top=%u", &n) == 1)
+			{
+				topCount = n;
+			}
+		}
+		else if(strstr(arg, "-ppem=") == arg)
+		{
+			f32 ppem;
+			if(sscanf(arg, "-ppem=%f", &ppem) == 1 && ppem >= 1.0f && ppem <= 4096.0f)
+			{
+				pixelsPerEm = ppem;
+			}
+		}
+		else if(strcmp(arg, "-glyphs") == 0)
+		{
+			printGlyphs = true;
+		}
+		else if(strstr(arg, "-json=") == arg)
+		{
+			jsonPath = arg + 6;
+		}
+	}
+
+	// Font::Load validates everything we'll read from the file's textures
+	const char* const inputPath = argv[1];
+	Font font;
+	if(!font.Load(inputPath, FONT_LOAD_BAND_CURVES))
+	{
+		return 1;
+	}
+
+	Buffer fileData;
+	if(!ReadEntireFile(fileData, inputPath))
+	{
+		PrintError("Failed to load file into memory: %s\n", inputPath);
+		return 1;
+	}
+
+	FileTextures textures;
+	const u8* data = (const u8*)fileData.buffer + FILE_HEADER_BYTES + font.codePoints.size() * sizeof(SluggishCodePoint);
+	memcpy(&textures.curvesTexels, data, sizeof(u32));
+	textures.curves = (const f32*)(data + 4);
+	data += 4 + (size_t)textures.curvesTexels * 16;
+	memcpy(&textures.bandsTexels, data, sizeof(u32));
+	textures.bands = (const u16*)(data + 4);
+
+	const u64 fileBytes = (u64)(data + 4 + (size_t)textures.bandsTexels * 4 - (const u8*)fileData.buffer);
+
+	FontStats stats;
+	std::vector<GlyphStats> glyphs;
+	InspectFont(stats, glyphs, font, textures, pixelsPerEm, fileBytes);
+
+	// ties are broken by code point to keep the list deterministic
+	std::vector<u32> top(glyphs.size());
+	for(u32 i = 0; i < (u32)top.size(); ++i)
+	{
+		top[i] = i;
+	}
+	std::sort(std::begin(top), std::end(top), [&glyphs](u32 a, u32 b)
+	{
+		if(glyphs[a].testsPerGlyph != glyphs[b].testsPerGlyph) return glyphs[a].testsPerGlyph > glyphs[b].testsPerGlyph;
+		return glyphs[a].codePoint < glyphs[b].codePoint;
+	});
+	top.resize(Min((size_t)topCount, top.size()));
+
+	PrintReport(font, stats, glyphs, top, pixelsPerEm, printGlyphs);
+
+	if(jsonPath != NULL)
+	{
+		if(!WriteResults(jsonPath, inputPath, font, stats, glyphs, top, pixelsPerEm))
+		{
+			FreeBuffer(fileData);
+			return 1;
+		}
+		PrintInfo("\n'%s' DONE\n", jsonPath);
+	}
+
+	FreeBuffer(fileData);
+
+	return 0;
+}
@@ -1,52 +1,74 @@
-#include "../shared.hpp"
+#include "../sluggish/font.hpp"
+#include "../sluggish/trace.hpp"
 #define SDL_MAIN_HANDLED
 #include "SDL.h"
 
 #include <Windows.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <math.h>
+#include <float.h>
 #include <assert.h>
 #include <gl/glew.h>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
 #include <vector>
 
 
 static const char* const vertexShader = R"alrightythen(
-#version 330
+#version 330 core
+
+#define GLYPH_SIZE_SCALE (1.0 / 8.0)
 
 layout (location = 0) in vec2 vaPosition;
 layout (location = 1) in vec2 vaTexCoords;
-layout (location = 2) in vec4 vaScaleBias;
-layout (location = 3) in vec4 vaGlyphBandScale;
-layout (location = 4) in uvec4 vaBandMaxTexCoords;
+layout (location = 2) in vec2 vaGlyphPosition;
+layout (location = 3) in vec2 vaGlyphSize;
+layout (location = 4) in uint vaGlyphIndex;
 out vec2 texCoords;
 flat out vec4 glyphBandScale;
 flat out uvec4 bandMaxTexCoords;
 
+// 2 texels per glyph
+// 0: glyph scale and bands scale (float bits)
+// 1: band max and bands tex coords
+uniform usamplerBuffer glyphsTex;
+uniform vec2 displaySize;
+uniform vec4 glyphTransform; // xy: scale, zw: offset in pixels
+
 void main()
 {
-	gl_Position =  vec4(vaPosition * vaScaleBias.xy + vaScaleBias.zw, 0.0, 1.0);
+	// the size is stored in fixed point
+	vec2 position = vaGlyphPosition * glyphTransform.xy + glyphTransform.zw;
+	vec2 scale = (vaGlyphSize * GLYPH_SIZE_SCALE * glyphTransform.xy) / displaySize;
+	vec2 bias = 2.0 * (position / displaySize) - 1.0 + scale;
+	gl_Position =  vec4(vaPosition * scale + bias, 0.0, 1.0);
 	texCoords = vaTexCoords;
-	glyphBandScale = vaGlyphBandScale;
-	bandMaxTexCoords = vaBandMaxTexCoords;
+	glyphBandScale = uintBitsToFloat(texelFetch(glyphsTex, int(vaGlyphIndex * 2U)));
+	bandMaxTexCoords = texelFetch(glyphsTex, int(vaGlyphIndex * 2U + 1U));
 }
 )alrightythen";
 
 static const char* const fragmentShader = R"alrightythen(
-#version 330
+#version 330 core
 
 in vec2 texCoords;
 flat in vec4 glyphBandScale;
 flat in uvec4 bandMaxTexCoords;
 out vec4 fragmentColor;
 
-uniform sampler2DRect curvesTex;
-uniform usampler2DRect bandsTex;
+uniform samplerBuffer curvesTex;
+uniform usamplerBuffer bandsTex;
 
 const float epsilon = 0.0001;
 
-#define glyphScale     glyphBandScale.xy
 #define bandScale      glyphBandScale.zw
 #define bandMax        bandMaxTexCoords.xy
-#define bandsTexCoords bandMaxTexCoords.zw
+#define bandsOffset    bandMaxTexCoords.z
+#define curvesOffset   bandMaxTexCoords.w
+
+// INLINE_CURVES gets defined by the application based on the font's layout
 
 // traces a horizontal ray against the curve with control points p1, p2, p3
 // to trace a vertical ray, we simply swizzle the input coordinates
@@ -102,6 +124,19 @@ float TraceRayCurveH(vec2 p1, vec2 p2, vec2 p3, float pixelsPerEm)
 	return coverage;
 }
 
+// returns the curves texel index of the band's specified curve
+int GetCurveTexel(uint curveList, uint curve)
+{
+#if INLINE_CURVES
+	// the band's curves are stored contiguously, 2 texels each
+	return int(curvesOffset + curveList + 2U * curve);
+#else
+	// the curve's texel index is split into its low and high 16 bits
+	uvec2 curveRef = texelFetch(bandsTex, int(bandsOffset + curveList + curve)).xy;
+	return int(curveRef.x | (curveRef.y << 16U));
+#endif
+}
+
 // traces a horizontal ray against all curves in the specified band
 // returns the coverage value
 float TraceRayBandH(uvec2 bandData, float pixelsPerEm)
@@ -111,10 +146,9 @@ float TraceRayBandH(uvec2 bandData, float pixelsPerEm)
 	// try intersecting against every curve in the selected band
 	for(uint curve = 0U; curve < bandData.x; ++curve)
 	{
-		uint curveOffset = bandData.y + curve;
-		ivec2 curveLoc = ivec2(texelFetch(bandsTex, ivec2(curveOffset & 0xFFFU, curveOffset >> 12U)).xy);
-		vec4 p12 = texelFetch(curvesTex, curveLoc) / vec4(glyphScale, glyphScale) - vec4(texCoords, texCoords);
-		vec2 p3 = texelFetch(curvesTex, ivec2(curveLoc.x + 1, curveLoc.y)).xy / glyphScale - texCoords;
+		int curveLoc = GetCurveTexel(bandData.y, curve);
+		vec4 p12 = texelFetch(curvesTex, curveLoc) - vec4(texCoords, texCoords);
+		vec2 p3 = texelFetch(curvesTex, curveLoc + 1).xy - texCoords;
 
 		coverage += TraceRayCurveH(p12.xy, p12.zw, p3.xy, pixelsPerEm);
 	}
@@ -131,10 +165,9 @@ float TraceRayBandV(uvec2 bandData, float pixelsPerEm)
 	// try intersecting against every curve in the selected band
 	for(uint curve = 0U; curve < bandData.x; ++curve)
 	{
-		uint curveOffset = bandData.y + curve;
-		ivec2 curveLoc = ivec2(texelFetch(bandsTex, ivec2(curveOffset & 0xFFFU, curveOffset >> 12U)).xy);
-		vec4 p12 = texelFetch(curvesTex, curveLoc) / vec4(glyphScale, glyphScale) - vec4(texCoords, texCoords);
-		vec2 p3 = texelFetch(curvesTex, ivec2(curveLoc.x + 1, curveLoc.y)).xy / glyphScale - texCoords;
+		int curveLoc = GetCurveTexel(bandData.y, curve);
+		vec4 p12 = texelFetch(curvesTex, curveLoc) - vec4(texCoords, texCoords);
+		vec2 p3 = texelFetch(curvesTex, curveLoc + 1).xy - texCoords;
 
 		coverage += TraceRayCurveH(p12.yx, p12.wz, p3.yx, pixelsPerEm);
 	}
@@ -155,15 +188,13 @@ void main()
 
 	// get the descriptor of the horizontal band we're in
 	// x : curve count
-	// y : absolute texel offset into the bands texture
-	uint hBandOffset = bandsTexCoords.y * 4096U + bandsTexCoords.x + bandIndex.y;
-	uvec2 hBandData = texelFetch(bandsTex, ivec2(hBandOffset & 0xFFFU, hBandOffset >> 12U)).xy;
+	// y : texel offset of the curve list, relative to the glyph's 1st band header (or 1st curve when inline)
+	uvec2 hBandData = texelFetch(bandsTex, int(bandsOffset + bandIndex.y)).xy;
 
 	// get the descriptor of the vertical band we're in
 	// x : curve count
-	// y : absolute texel offset into the bands texture
-	uint vBandOffset = bandsTexCoords.y * 4096U + bandsTexCoords.x + bandMax.y + 1U + bandIndex.x;
-	uvec2 vBandData = texelFetch(bandsTex, ivec2(vBandOffset & 0xFFFU, vBandOffset >> 12U)).xy;
+	// y : texel offset of the curve list, relative to the glyph's 1st band header (or 1st curve when inline)
+	uvec2 vBandData = texelFetch(bandsTex, int(bandsOffset + bandMax.y + 1U + bandIndex.x)).xy;
 
 	// compute coverage values for each axis by tracing a horizontal ray and a vertical ray
 	float coverageX = TraceRayBandH(hBandData, pixelsPerEm.x);
@@ -177,15 +208,47 @@ void main()
 )alrightythen";
 
 
+// fills a rectangle with a solid color
+static const char* const solidVertexShader = R"alrightythen(
+#version 330 core
+
+layout (location = 0) in vec2 vaPosition;
+
+uniform vec4 rect; // x1 y1 x2 y2 in normalized device coordinates
+
+void main()
+{
+	gl_Position = vec4(mix(rect.xy, rect.zw, vaPosition * 0.5 + 0.5), 0.0, 1.0);
+}
+)alrightythen";
+
+static const char* const solidFragmentShader = R"alrightythen(
+#version 330 core
+
+out vec4 fragmentColor;
+
+uniform vec4 color;
+
+void main()
+{
+	fragmentColor = color;
+}
+)alrightythen";
+
+
 struct System
 {
-	u64 frameDurationsUS[1 << 12];
-	u32 frameCount;
 	SDL_Window* window;
 	SDL_GLContext glContext;
 	int displayWidth;
 	int displayHeight;
 	bool quit;
+
+	// offscreen rendering
+	bool headless;
+	bool coverageScene; // a single glyph stretched over the whole target, for diffing against fontrender
+	u32 headlessFrames;
+	const char* outputPath;
 };
 
 struct GLSL_Program
@@ -195,46 +258,149 @@ struct GLSL_Program
 	GLuint fs; // fragment shader
 };
 
+// glyph instances are streamed through a ring of buffer segments
+// each segment is guarded by a fence so that we never overwrite data the GPU hasn't consumed yet
+#define RING_SEGMENT_COUNT  3
+#define RING_SEGMENT_GLYPHS (1 << 16)
+
+// glyph sizes are sent in 1/8th of a pixel units
+// this must match GLYPH_SIZE_SCALE in the vertex shader
+#define GLYPH_SIZE_SCALE 8.0f
+
 #pragma pack(push, 1)
 
-struct float4
+// everything that's constant for a given glyph lives in the glyphs buffer texture
+struct GlyphInstance
 {
-	f32 x, y, z, w;
+	f32 x, y;           // bottom-left corner in pixels
+	u16 width, height;  // fixed point, see GLYPH_SIZE_SCALE
+	u32 glyphIndex;     // index into the glyphs buffer texture
 };
 
-struct ushort2
+struct GlyphData
 {
-	u16 x, y;
+	f32 glyphBandScale[4];
+	u32 bandMaxTexCoords[4];
 };
 
 #pragma pack(pop)
 
-#define MAX_GLYPHS 64
+struct InstanceRing
+{
+	GLuint vbo;
+	GlyphInstance* mapped; // persistent: the whole buffer, otherwise: the range starting at mapIndex (NULL when unmapped)
+	GLsync fences[RING_SEGMENT_COUNT];
+	u32 segment;    // the segment being filled
+	u32 writeIndex; // next instance to write in the segment
+	u32 drawIndex;  // first instance of the segment not drawn yet
+	u32 mapIndex;
+	bool persistent;
+};
+
+// consecutive glyphs of a text block are grouped into chunks
+// chunks outside of the view don't get drawn
+#define TEXT_CHUNK_GLYPHS 256
+
+struct TextChunk
+{
+	f32 x1, y1, x2, y2; // bounding box in the block's space
+	u32 firstGlyph;
+	u32 glyphCount;
+	f32 area; // sum of the glyph quad areas
+};
+
+// retained glyphs: laid out and uploaded once, then drawn with a few calls every frame
+// the GPU copy only gets rebuilt when the contents change
+struct TextBlock
+{
+	std::vector<GlyphInstance> glyphs;
+	std::vector<TextChunk> chunks;
+	std::string text; // what Text_SetString last laid out
+	GLuint vbo;
+	GLuint vao;
+	u32 capacity;   // number of glyphs the VBO can hold
+	u32 glyphCount; // number of glyphs in the VBO
+	u32 visibleGlyphCount; // as of the last draw
+	f32 x, y, scale;
+	bool fixed; // ignores the view's zoom and pan
+	bool dirty;
+};
+
+// GL_TIME_ELAPSED queries are double-buffered: we read a query's result right before re-using it,
+// by which point the GPU has long finished that frame
+#define STATS_QUERY_COUNT 2
+
+// the stats are reported, logged and shown once per interval
+#define STATS_INTERVAL_US 1000000
+
+struct FrameSample
+{
+	u32 frame;
+	f32 frameUS;  // wall-clock time between 2 frames (includes swap and vsync)
+	f32 submitUS; // CPU time spent issuing the glyph draws
+	f32 glyphPixels; // screen area of all the glyph quads drawn
+	bool pending; // waiting for the GPU time
+};
+
+struct FrameStats
+{
+	std::vector<f32> frameUS;
+	std::vector<f32> submitUS;
+	std::vector<f32> gpuUS;
+	f64 gpuTotalUS;
+	f64 glyphPixelsTotal;
+	FrameSample samples[STATS_QUERY_COUNT];
+	GLuint queries[STATS_QUERY_COUNT];
+	bool timerQueries;
+	u32 frame;
+	f32 glyphPixels; // of the current frame
+	LARGE_INTEGER lastFrame;
+	LARGE_INTEGER intervalStart;
+	LARGE_INTEGER submitStart;
+	File csvFile;
+	bool csv;
+};
 
 struct OpenGL
 {
 	// general
-	std::vector<SluggishCodePoint> codePoints;
+	Font font;
 	f32 zoomOffsetX, zoomOffsetY, zoom;
 	int cursorX, cursorY;
 	bool drawText = true;
+	u32 stressGlyphCount;
 
 	// GL handles
 	GLSL_Program program;
-	GLuint curvesTex, bandsTex;
+	GLSL_Program solidProgram;
+	GLint glyphTransformLoc;
+	GLint solidRectLoc, solidColorLoc;
+	GLuint solidVAO;
+	GLuint curvesTex, curvesTBO;
+	GLuint bandsTex, bandsTBO;
+	GLuint glyphsTex, glyphsTBO;
 	GLuint quadVBO, quadVAO;
-	GLuint scaleBiasVBO, glyphBandScaleVBO, bandMaxTexCoordsVBO;
+	GLuint offscreenFBO, offscreenRB;
 
-	// data for a single draw call
-	f32 scaleAndBias[MAX_GLYPHS][4];
-	f32 glyphBandScale[MAX_GLYPHS][4];
-	u32 bandMaxTexCoords[MAX_GLYPHS][4];
-	u32 glyphCount;
+	// per-instance data
+	InstanceRing ring;
+
+	// retained text
+	TextBlock mainBlock;
+	bool mainBlockValid;
+	TextBlock docBlock;
+	bool drawDoc;
+	TextBlock statsBlock;
+	bool drawStats;
+
+	FrameStats stats;
 };
 
 static System sys;
 static OpenGL gl;
 static char g_text[256];
+static const char* g_docPath = NULL;
+static f32 g_docPixelsPerEm = 16.0f;
 
 
 static const char* GL_ErrorString(GLenum error)
@@ -279,83 +445,76 @@ static void GL_CheckErrors()
 	FatalError("OpenGL error(s)!");
 }
 
+// the data is immutable, texelFetch is the only way it gets read
+static void GL_CreateBufferTexture(GLuint* texture, GLuint* buffer, GLenum internalFormat, const void* data, size_t bytes)
+{
+	TRACE_ZONE("GL_CreateBufferTexture");
+
+	glGenBuffers(1, buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, *buffer);
+	glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)bytes, data, GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glGenTextures(1, texture);
+	glBindTexture(GL_TEXTURE_BUFFER, *texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, *buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	GL_CheckErrors();
+}
+
 static void Font_Load(const char* inputPath)
 {
-	File file;
-	if(!file.Open(inputPath, "rb"))
-	{
-		FatalError("Failed to open font file: %s\n", inputPath);
-	}
+	TRACE_ZONE("Font_Load");
 
-	char header[SLUGGISH_HEADER_LEN + 1];
-	file.Read(header, SLUGGISH_HEADER_LEN);
-	header[SLUGGISH_HEADER_LEN] = '\0';
-	if(strcmp(header, SLUGGISH_HEADER_DATA) != 0)
+	if(!gl.font.Load(inputPath, FONT_LOAD_TEXTURES))
 	{
-		FatalError("Invalid header found (%s instead of %s): %s\n", header, SLUGGISH_HEADER_DATA, inputPath);
+		FatalError("Failed to load font: %s\n", inputPath);
 	}
 
-	u16 codePointCount = 0;
-	file.Read(&codePointCount, sizeof(codePointCount));
-	if(codePointCount == 0)
+	const Font& font = gl.font;
+	const u32 codePointCount = (u32)font.codePoints.size();
+	const u32 curveTexTexels = (u32)(font.curvesTexture.size() / 4);
+	const u32 bandsTexTexels = (u32)(font.bandsTexture.size() / 2);
+
+	GLint maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	if(curveTexTexels > (u32)maxTexels)
 	{
-		FatalError("No code points found: %s\n", inputPath);
+		FatalError("Curves texture too big (%u texels, max. %d): %s\n", (unsigned int)curveTexTexels, (int)maxTexels, inputPath);
 	}
-
-	gl.codePoints.resize((size_t)codePointCount);
-	file.Read(&gl.codePoints[0], gl.codePoints.size() * sizeof(SluggishCodePoint));
-
-	u16 curveTextureWidth;
-	u16 curveTextureHeight;
-	u32 curveTextureBytes;
-	file.Read(&curveTextureWidth, sizeof(curveTextureWidth));
-	file.Read(&curveTextureHeight, sizeof(curveTextureHeight));
-	file.Read(&curveTextureBytes, sizeof(curveTextureBytes));
-	if(curveTextureWidth == 0 || curveTextureHeight == 0 || curveTextureBytes == 0 || curveTextureWidth != TEXTURE_WIDTH)
+	if(bandsTexTexels > (u32)maxTexels)
 	{
-		FatalError("Invalid curves texture dimensions: %s\n", inputPath);
+		FatalError("Bands texture too big (%u texels, max. %d): %s\n", (unsigned int)bandsTexTexels, (int)maxTexels, inputPath);
 	}
 
-	const size_t curveTexTexels = (size_t)curveTextureWidth * (size_t)curveTextureHeight;
-	std::vector<float4> curvesTexture;
-	curvesTexture.resize(curveTexTexels);
-	memset(&curvesTexture[0], 0xCD, curveTexTexels * sizeof(curvesTexture[0])); // @TODO: fix up constant
-	file.Read(&curvesTexture[0], (size_t)curveTextureBytes);
-
-	u16 bandsTextureWidth;
-	u16 bandsTextureHeight;
-	u32 bandsTextureBytes;
-	file.Read(&bandsTextureWidth, sizeof(bandsTextureWidth));
-	file.Read(&bandsTextureHeight, sizeof(bandsTextureHeight));
-	file.Read(&bandsTextureBytes, sizeof(bandsTextureBytes));
-	if(bandsTextureWidth == 0 || bandsTextureHeight == 0 || bandsTextureBytes == 0 || bandsTextureWidth != TEXTURE_WIDTH)
+	std::vector<GlyphData> glyphs;
+	glyphs.resize((size_t)codePointCount);
+	for(u32 i = 0; i < codePointCount; ++i)
 	{
-		FatalError("Invalid bands texture dimensions: %s\n", inputPath);
+		const SluggishCodePoint& cp = font.codePoints[i];
+		GlyphData& glyph = glyphs[i];
+		glyph.glyphBandScale[0] = (f32)cp.width;
+		glyph.glyphBandScale[1] = (f32)cp.height;
+		glyph.glyphBandScale[2] = (f32)cp.width / (f32)cp.bandDimX;
+		glyph.glyphBandScale[3] = (f32)cp.height / (f32)cp.bandDimY;
+		glyph.bandMaxTexCoords[0] = cp.bandCount - 1;
+		glyph.bandMaxTexCoords[1] = cp.bandCount - 1;
+		glyph.bandMaxTexCoords[2] = cp.bandsTexelIndex;
+		glyph.bandMaxTexCoords[3] = cp.curvesTexelIndex;
 	}
 
-	const size_t bandsTexTexels = (size_t)bandsTextureWidth * (size_t)bandsTextureHeight;
-	std::vector<ushort2> bandsTexture;
-	bandsTexture.resize(bandsTexTexels);
-	memset(&bandsTexture[0], 0xAB, bandsTexTexels * sizeof(bandsTexture[0])); // @TODO: fix up constant
-	file.Read(&bandsTexture[0], (size_t)bandsTextureBytes);
+	PrintInfo("Font data: %u curves texels + %u bands texels, %.1f KB (%s layout)\n",
+			  (unsigned int)curveTexTexels, (unsigned int)bandsTexTexels,
+			  (f64)(font.curvesTexture.size() * sizeof(f32) + font.bandsTexture.size() * sizeof(u16)) / 1024.0,
+			  (font.info.flags & SLUGGISH_FLAG_INLINE_CURVES) != 0 ? "inline" : "indexed");
 
-	PrintInfo("Creating bands textures...\n");
-	glGenTextures(1, &gl.bandsTex);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gl.bandsTex);
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RG16UI, bandsTextureWidth, bandsTextureHeight, 0, GL_RG_INTEGER, GL_UNSIGNED_SHORT, &bandsTexture[0]);
-	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // required for integer textures
-	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_NEAREST); // required for integer textures
-	GL_CheckErrors();
-	
-	PrintInfo("Creating curves textures...\n");
-	glGenTextures(1, &gl.curvesTex);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gl.curvesTex);
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA32F, curveTextureWidth, curveTextureHeight, 0, GL_RGBA, GL_FLOAT, &curvesTexture[0]);
-	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	GL_CheckErrors();
+	PrintInfo("Creating bands buffer texture...\n");
+	GL_CreateBufferTexture(&gl.bandsTex, &gl.bandsTBO, GL_RG16UI, &font.bandsTexture[0], font.bandsTexture.size() * sizeof(u16));
 
-	glBindTexture(GL_TEXTURE_RECTANGLE, 0);
+	PrintInfo("Creating curves buffer texture...\n");
+	GL_CreateBufferTexture(&gl.curvesTex, &gl.curvesTBO, GL_RGBA32F, &font.curvesTexture[0], font.curvesTexture.size() * sizeof(f32));
+
+	PrintInfo("Creating glyphs buffer texture...\n");
+	GL_CreateBufferTexture(&gl.glyphsTex, &gl.glyphsTBO, GL_RGBA32UI, &glyphs[0], glyphs.size() * sizeof(GlyphData));
 }
 
 static void GL_PrintShaderLog(GLuint shader, GLenum shaderType)
@@ -390,10 +549,20 @@ static void GL_UnbindProgram()
 	glUseProgram(0);
 }
 
-static bool GL_CreateShader(GLuint* shaderPtr, GLenum shaderType, const char* shaderSource)
+// defines can be NULL, otherwise it gets inserted right after the #version line
+static bool GL_CreateShader(GLuint* shaderPtr, GLenum shaderType, const char* shaderSource, const char* defines)
 {
+	std::string source = shaderSource;
+	if(defines != NULL)
+	{
+		const size_t versionLine = source.find("#version");
+		const size_t lineEnd = versionLine != std::string::npos ? source.find('\n', versionLine) : std::string::npos;
+		source.insert(lineEnd != std::string::npos ? lineEnd + 1 : 0, defines);
+	}
+
+	const char* const sourcePtr = source.c_str();
 	GLuint shader = glCreateShader(shaderType);
-	glShaderSource(shader, 1, &shaderSource, NULL);
+	glShaderSource(shader, 1, &sourcePtr, NULL);
 	glCompileShader(shader);
 
 	GLint result = GL_FALSE;
@@ -408,14 +577,16 @@ static bool GL_CreateShader(GLuint* shaderPtr, GLenum shaderType, const char* sh
 	return false;
 }
 
-static bool GL_CreateProgram(GLSL_Program& prog, const char* vs, const char* fs)
+static bool GL_CreateProgram(GLSL_Program& prog, const char* vs, const char* fs, const char* defines = NULL)
 {
-	if(!GL_CreateShader(&prog.vs, GL_VERTEX_SHADER, vs))
+	TRACE_ZONE("GL_CreateProgram");
+
+	if(!GL_CreateShader(&prog.vs, GL_VERTEX_SHADER, vs, defines))
 	{
 		return false;
 	}
 		
-	if(!GL_CreateShader(&prog.fs, GL_FRAGMENT_SHADER, fs))
+	if(!GL_CreateShader(&prog.fs, GL_FRAGMENT_SHADER, fs, defines))
 	{
 		return false;
 	}
@@ -436,192 +607,873 @@ static bool GL_CreateProgram(GLSL_Program& prog, const char* vs, const char* fs)
 	return true;
 }
 
-static void GL_RenderAllGlyphs(const GLSL_Program& program)
+static void GL_SetInstanceAttribs(GLuint vbo, u32 firstInstance)
 {
-	const u32 glyphCount = gl.glyphCount;
-	gl.glyphCount = 0;
+	const uptr base = (uptr)firstInstance * sizeof(GlyphInstance);
 
-	GL_BindProgram(program);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(GlyphInstance), (void*)(base + offsetof(GlyphInstance, x)));
+	glVertexAttribPointer(3, 2, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(GlyphInstance), (void*)(base + offsetof(GlyphInstance, width)));
+	glVertexAttribIPointer(4, 1, GL_UNSIGNED_INT, sizeof(GlyphInstance), (void*)(base + offsetof(GlyphInstance, glyphIndex)));
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, gl.scaleBiasVBO);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, 16 * glyphCount, gl.scaleAndBias);
-	GL_CheckErrors();
+static void GL_CreateGlyphVAO(GLuint* vaoPtr, GLuint instanceVBO)
+{
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
 
-	glBindBuffer(GL_ARRAY_BUFFER, gl.glyphBandScaleVBO);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, 16 * glyphCount, gl.glyphBandScale);
-	GL_CheckErrors();
+	// float2 positions
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, gl.quadVBO);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+
+	// float2 texture coordinates
+	glEnableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, gl.quadVBO);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
-	glBindBuffer(GL_ARRAY_BUFFER, gl.bandMaxTexCoordsVBO);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, 16 * glyphCount, gl.bandMaxTexCoords);
+	// float2 glyph position
+	// ushort2 glyph size
+	// uint glyph index
+	glEnableVertexAttribArray(2);
+	glEnableVertexAttribArray(3);
+	glEnableVertexAttribArray(4);
+	GL_SetInstanceAttribs(instanceVBO, 0);
+	glVertexAttribDivisor(2, 1);
+	glVertexAttribDivisor(3, 1);
+	glVertexAttribDivisor(4, 1);
 	GL_CheckErrors();
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	*vaoPtr = vao;
+}
+
+// x, y: offset in pixels
+static void GL_BeginGlyphs(const GLSL_Program& program, f32 x, f32 y, f32 scale)
+{
+	// the samplers and display size were set up at link time
+	GL_BindProgram(program);
 
 	glActiveTexture(GL_TEXTURE0 + 0);
-	glEnable(GL_TEXTURE_RECTANGLE);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gl.curvesTex);
-	glUniform1i(glGetUniformLocation(program.p, "curvesTex"), 0);
-	GL_CheckErrors();
+	glBindTexture(GL_TEXTURE_BUFFER, gl.curvesTex);
 
 	glActiveTexture(GL_TEXTURE0 + 1);
-	glEnable(GL_TEXTURE_RECTANGLE);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gl.bandsTex);
-	glUniform1i(glGetUniformLocation(program.p, "bandsTex"), 1);
-	GL_CheckErrors();
+	glBindTexture(GL_TEXTURE_BUFFER, gl.bandsTex);
 
-	glBindVertexArray(gl.quadVAO);
-	GL_CheckErrors();
-	glDrawArraysInstanced(GL_QUADS, 0, 4, glyphCount);
+	glActiveTexture(GL_TEXTURE0 + 2);
+	glBindTexture(GL_TEXTURE_BUFFER, gl.glyphsTex);
+
+	glUniform4f(gl.glyphTransformLoc, scale, scale, x, y);
 	GL_CheckErrors();
+}
+
+static void GL_EndGlyphs()
+{
+	glBindVertexArray(0);
 
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glBindTexture(GL_TEXTURE_RECTANGLE, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
 
 	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glBindTexture(GL_TEXTURE_RECTANGLE, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
 
 	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glBindTexture(GL_TEXTURE_RECTANGLE, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
 
 	GL_UnbindProgram();
 	GL_CheckErrors();
 }
 
+static void GL_RenderAllGlyphs(const GLSL_Program& program)
+{
+	TRACE_ZONE("GL_RenderAllGlyphs");
+
+	InstanceRing& ring = gl.ring;
+	const u32 glyphCount = ring.writeIndex - ring.drawIndex;
+	if(glyphCount == 0)
+	{
+		return;
+	}
+
+	if(!ring.persistent && ring.mapped != NULL)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, ring.vbo);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		ring.mapped = NULL;
+	}
+
+	GL_BeginGlyphs(program, gl.zoomOffsetX, gl.zoomOffsetY, gl.zoom);
+	glBindVertexArray(gl.quadVAO);
+	GL_SetInstanceAttribs(ring.vbo, ring.segment * RING_SEGMENT_GLYPHS + ring.drawIndex);
+	GL_CheckErrors();
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, glyphCount);
+	GL_CheckErrors();
+	ring.drawIndex = ring.writeIndex;
+	GL_EndGlyphs();
+}
+
+static void GL_NextRingSegment()
+{
+	InstanceRing& ring = gl.ring;
+
+	// the GPU signals the fence once it's done with every draw call sourcing this segment
+	ring.fences[ring.segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ring.segment = (ring.segment + 1) % RING_SEGMENT_COUNT;
+	ring.writeIndex = 0;
+	ring.drawIndex = 0;
+
+	// we only stall here if the GPU is a whole ring behind
+	GLsync& fence = ring.fences[ring.segment];
+	if(fence != NULL)
+	{
+		for(;;)
+		{
+			const GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			if(result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+			{
+				break;
+			}
+			if(result == GL_WAIT_FAILED)
+			{
+				FatalError("glClientWaitSync failed");
+			}
+		}
+
+		glDeleteSync(fence);
+		fence = NULL;
+	}
+}
+
+static GlyphInstance* GL_AllocGlyphInstance()
+{
+	InstanceRing& ring = gl.ring;
+	if(ring.writeIndex == RING_SEGMENT_GLYPHS)
+	{
+		GL_RenderAllGlyphs(gl.program);
+		GL_NextRingSegment();
+	}
+
+	const u32 index = ring.segment * RING_SEGMENT_GLYPHS + ring.writeIndex++;
+	if(ring.persistent)
+	{
+		return &ring.mapped[index];
+	}
+
+	if(ring.mapped == NULL)
+	{
+		// the segment's fence was waited on, so we don't need the driver to synchronize
+		const u32 segmentEnd = (ring.segment + 1) * RING_SEGMENT_GLYPHS;
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+		glBindBuffer(GL_ARRAY_BUFFER, ring.vbo);
+		ring.mapped = (GlyphInstance*)glMapBufferRange(GL_ARRAY_BUFFER, (GLintptr)index * sizeof(GlyphInstance), (GLsizeiptr)(segmentEnd - index) * sizeof(GlyphInstance), flags);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if(ring.mapped == NULL)
+		{
+			FatalError("Failed to map the glyph instance buffer");
+		}
+		ring.mapIndex = index;
+	}
+
+	return &ring.mapped[index - ring.mapIndex];
+}
+
+static void GL_WriteGlyphInstance(GlyphInstance* gi, u32 glyphIndex, f32 x, f32 y, f32 w, f32 h)
+{
+	gi->x = x;
+	gi->y = y;
+	gi->width = (u16)Clamp(w * GLYPH_SIZE_SCALE + 0.5f, 0.0f, 65535.0f);
+	gi->height = (u16)Clamp(h * GLYPH_SIZE_SCALE + 0.5f, 0.0f, 65535.0f);
+	gi->glyphIndex = glyphIndex;
+}
+
 static void GL_RenderGlyph(u32 codePoint, f32 x, f32 y, f32 w, f32 h)
 {
-	SluggishCodePoint cp = { 0 };
-	bool found = false;
-	for(const auto& c : gl.codePoints)
+	const s32 glyphIndex = gl.font.FindGlyphIndex(codePoint);
+	if(glyphIndex < 0)
+	{
+		return;
+	}
+
+	// the instance lives in write-combined memory: write it sequentially and never read it back
+	GL_WriteGlyphInstance(GL_AllocGlyphInstance(), (u32)glyphIndex, x, y, w, h);
+	gl.stats.glyphPixels += w * h * gl.zoom * gl.zoom;
+}
+
+static void Text_CreateBlock(TextBlock& block)
+{
+	glGenBuffers(1, &block.vbo);
+	GL_CreateGlyphVAO(&block.vao, block.vbo);
+	block.capacity = 0;
+	block.glyphCount = 0;
+	block.visibleGlyphCount = 0;
+	block.x = 0.0f;
+	block.y = 0.0f;
+	block.scale = 1.0f;
+	block.fixed = false;
+	block.dirty = false;
+}
+
+static void Text_Clear(TextBlock& block)
+{
+	block.glyphs.clear();
+	block.text.clear();
+	block.dirty = true;
+}
+
+// stretches the glyph's bounding box to the specified rectangle
+static void Text_AddGlyph(TextBlock& block, u32 codePoint, f32 x, f32 y, f32 w, f32 h)
+{
+	const s32 glyphIndex = gl.font.FindGlyphIndex(codePoint);
+	if(glyphIndex < 0)
+	{
+		return;
+	}
+
+	GlyphInstance gi;
+	GL_WriteGlyphInstance(&gi, (u32)glyphIndex, x, y, w, h);
+	block.glyphs.push_back(gi);
+	block.dirty = true;
+}
+
+// lays out a string with the font's metrics
+// x, y: position of the first line's baseline in pixels
+// code points missing from the font (e.g. spaces, which have no outline) advance the pen by a quarter em
+static void Text_AddString(TextBlock& block, const char* text, f32 x, f32 y, f32 pixelsPerEm)
+{
+	FontMetrics metrics;
+	gl.font.GetMetrics(metrics, pixelsPerEm);
+	const f32 s = metrics.pixelsPerUnit;
+	const f32 lineHeight = metrics.lineHeight;
+
+	f32 penX = x;
+	f32 penY = y;
+	for(const char* c = text; *c != '\0'; ++c)
 	{
-		if(c.codePoint == codePoint)
+		const u32 codePoint = (u32)(u8)*c;
+		if(codePoint == '\n')
 		{
-			found = true;
-			cp = c;
-			break;
+			penX = x;
+			penY -= lineHeight;
+			continue;
+		}
+
+		if(codePoint == '\r')
+		{
+			continue;
 		}
+
+		const s32 glyphIndex = gl.font.FindGlyphIndex(codePoint);
+		if(glyphIndex < 0)
+		{
+			penX += 0.25f * pixelsPerEm;
+			continue;
+		}
+
+		const SluggishCodePoint& cp = gl.font.codePoints[glyphIndex];
+		GlyphInstance gi;
+		GL_WriteGlyphInstance(&gi, (u32)glyphIndex, penX + (f32)cp.bearingX * s, penY + (f32)cp.bearingY * s, (f32)cp.width * s, (f32)cp.height * s);
+		block.glyphs.push_back(gi);
+		penX += (f32)cp.advance * s;
 	}
 
-	if(!found)
+	block.dirty = true;
+}
+
+// only lays the text out again when it changed
+static void Text_SetString(TextBlock& block, const char* text, f32 pixelsPerEm)
+{
+	if(!block.dirty && block.text == text)
 	{
 		return;
 	}
 
-	const u32 gi = gl.glyphCount;
-	const f32 dw = (f32)sys.displayWidth;
-	const f32 dh = (f32)sys.displayHeight;
-	const f32 sx = w / dw;
-	const f32 sy = h / dh;
-	gl.scaleAndBias[gi][0] = sx;
-	gl.scaleAndBias[gi][1] = sy;
-	gl.scaleAndBias[gi][2] = 2.0f * (x / dw) - 1.0f + sx;
-	gl.scaleAndBias[gi][3] = 2.0f * (y / dh) - 1.0f + sy;
+	Text_Clear(block);
+	Text_AddString(block, text, 0.0f, 0.0f, pixelsPerEm);
+	block.text = text;
+}
 
-	gl.glyphBandScale[gi][0] = (f32)cp.width;
-	gl.glyphBandScale[gi][1] = (f32)cp.height;
-	gl.glyphBandScale[gi][2] = (f32)cp.width / (f32)cp.bandDimX;
-	gl.glyphBandScale[gi][3] = (f32)cp.height / (f32)cp.bandDimY;
+static void Text_SetTransform(TextBlock& block, f32 x, f32 y, f32 scale)
+{
+	block.x = x;
+	block.y = y;
+	block.scale = scale;
+}
 
-	gl.bandMaxTexCoords[gi][0] = cp.bandCount - 1;
-	gl.bandMaxTexCoords[gi][1] = cp.bandCount - 1;
-	gl.bandMaxTexCoords[gi][2] = cp.bandsTexCoordX;
-	gl.bandMaxTexCoords[gi][3] = cp.bandsTexCoordY;
+static void Text_BuildChunks(TextBlock& block)
+{
+	block.chunks.clear();
 
-	++gl.glyphCount;
-	if(gl.glyphCount == MAX_GLYPHS)
+	const u32 glyphCount = (u32)block.glyphs.size();
+	for(u32 first = 0; first < glyphCount; first += TEXT_CHUNK_GLYPHS)
 	{
-		GL_RenderAllGlyphs(gl.program);
+		TextChunk chunk;
+		chunk.firstGlyph = first;
+		chunk.glyphCount = Min(glyphCount - first, (u32)TEXT_CHUNK_GLYPHS);
+		chunk.x1 = chunk.y1 = FLT_MAX;
+		chunk.x2 = chunk.y2 = -FLT_MAX;
+		chunk.area = 0.0f;
+		for(u32 i = first; i < first + chunk.glyphCount; ++i)
+		{
+			const GlyphInstance& gi = block.glyphs[i];
+			const f32 w = (f32)gi.width / GLYPH_SIZE_SCALE;
+			const f32 h = (f32)gi.height / GLYPH_SIZE_SCALE;
+			chunk.x1 = Min(chunk.x1, gi.x);
+			chunk.y1 = Min(chunk.y1, gi.y);
+			chunk.x2 = Max(chunk.x2, gi.x + w);
+			chunk.y2 = Max(chunk.y2, gi.y + h);
+			chunk.area += w * h;
+		}
+		block.chunks.push_back(chunk);
+	}
+}
+
+static void Text_DrawGlyphRange(TextBlock& block, u32 firstGlyph, u32 glyphCount)
+{
+	if(glyphCount == 0)
+	{
+		return;
+	}
+
+	// no base instance in GL 3.3, so we move the attributes instead
+	GL_SetInstanceAttribs(block.vbo, firstGlyph);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, glyphCount);
+	GL_CheckErrors();
+	block.visibleGlyphCount += glyphCount;
+}
+
+static void Text_DrawBlock(TextBlock& block)
+{
+	TRACE_ZONE("Text_DrawBlock");
+
+	if(block.dirty)
+	{
+		const u32 glyphCount = (u32)block.glyphs.size();
+		glBindBuffer(GL_ARRAY_BUFFER, block.vbo);
+		if(glyphCount > block.capacity)
+		{
+			glBufferData(GL_ARRAY_BUFFER, glyphCount * sizeof(GlyphInstance), &block.glyphs[0], GL_STATIC_DRAW);
+			block.capacity = glyphCount;
+		}
+		else if(glyphCount > 0)
+		{
+			glBufferSubData(GL_ARRAY_BUFFER, 0, glyphCount * sizeof(GlyphInstance), &block.glyphs[0]);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		GL_CheckErrors();
+
+		Text_BuildChunks(block);
+		block.glyphCount = glyphCount;
+		block.dirty = false;
+	}
+
+	block.visibleGlyphCount = 0;
+	if(block.glyphCount == 0)
+	{
+		return;
+	}
+
+	// the window's rectangle in the block's space
+	const f32 zoom = block.fixed ? 1.0f : gl.zoom;
+	const f32 scale = zoom * block.scale;
+	const f32 offsetX = (block.fixed ? 0.0f : gl.zoomOffsetX) + zoom * block.x;
+	const f32 offsetY = (block.fixed ? 0.0f : gl.zoomOffsetY) + zoom * block.y;
+	const f32 viewX1 = -offsetX / scale;
+	const f32 viewY1 = -offsetY / scale;
+	const f32 viewX2 = ((f32)sys.displayWidth - offsetX) / scale;
+	const f32 viewY2 = ((f32)sys.displayHeight - offsetY) / scale;
+
+	GL_BeginGlyphs(gl.program, offsetX, offsetY, scale);
+	glBindVertexArray(block.vao);
+
+	// visible chunks that are next to each other get drawn together
+	u32 runFirst = 0;
+	u32 runCount = 0;
+	f32 area = 0.0f;
+	for(const auto& chunk : block.chunks)
+	{
+		if(chunk.x2 < viewX1 || chunk.x1 > viewX2 || chunk.y2 < viewY1 || chunk.y1 > viewY2)
+		{
+			continue;
+		}
+
+		area += chunk.area;
+		if(chunk.firstGlyph != runFirst + runCount)
+		{
+			Text_DrawGlyphRange(block, runFirst, runCount);
+			runFirst = chunk.firstGlyph;
+			runCount = 0;
+		}
+		runCount += chunk.glyphCount;
+	}
+	Text_DrawGlyphRange(block, runFirst, runCount);
+	gl.stats.glyphPixels += area * scale * scale;
+
+	GL_EndGlyphs();
+}
+
+static bool Text_LoadDocument(TextBlock& block, const char* path, f32 pixelsPerEm)
+{
+	TRACE_ZONE("Text_LoadDocument");
+
+	Buffer text;
+	if(!ReadEntireFile(text, path))
+	{
+		PrintError("Failed to read document: %s\n", path);
+		return false;
+	}
+
+	// the first baseline is one ascent below the top of the window
+	const f32 margin = 8.0f;
+	const f32 top = (f32)sys.displayHeight - margin - (f32)gl.font.info.ascent * pixelsPerEm / (f32)gl.font.info.unitsPerEm;
+	Text_Clear(block);
+	Text_AddString(block, (const char*)text.buffer, margin, top, pixelsPerEm);
+	FreeBuffer(text);
+	PrintInfo("Document: %u glyphs in %u chunks\n",
+			  (unsigned int)block.glyphs.size(), (unsigned int)((block.glyphs.size() + TEXT_CHUNK_GLYPHS - 1) / TEXT_CHUNK_GLYPHS));
+
+	return true;
+}
+
+static void GL_CreateInstanceRing()
+{
+	InstanceRing& ring = gl.ring;
+	const GLsizeiptr bytes = (GLsizeiptr)RING_SEGMENT_COUNT * RING_SEGMENT_GLYPHS * sizeof(GlyphInstance);
+
+	glGenBuffers(1, &ring.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, ring.vbo);
+	ring.persistent = GLEW_ARB_buffer_storage != GL_FALSE;
+	if(ring.persistent)
+	{
+		// mapped once for the lifetime of the buffer
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, bytes, NULL, flags);
+		ring.mapped = (GlyphInstance*)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags);
+		if(ring.mapped == NULL)
+		{
+			FatalError("Failed to map the glyph instance buffer");
+		}
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+		ring.mapped = NULL;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GL_CheckErrors();
+
+	for(u32 i = 0; i < RING_SEGMENT_COUNT; ++i)
+	{
+		ring.fences[i] = NULL;
+	}
+	ring.segment = 0;
+	ring.writeIndex = 0;
+	ring.drawIndex = 0;
+	ring.mapIndex = 0;
+
+	PrintInfo("Glyph instance ring: %u x %u glyphs (%s mapping)\n",
+			  RING_SEGMENT_COUNT, RING_SEGMENT_GLYPHS, ring.persistent ? "persistent" : "unsynchronized");
+}
+
+static void Stats_Init(const char* csvPath)
+{
+	FrameStats& stats = gl.stats;
+	stats.timerQueries = GLEW_ARB_timer_query != GL_FALSE;
+	if(stats.timerQueries)
+	{
+		glGenQueries(STATS_QUERY_COUNT, stats.queries);
+	}
+	else
+	{
+		PrintWarning("GL_ARB_timer_query isn't supported, GPU times won't be available\n");
+	}
+
+	for(u32 i = 0; i < STATS_QUERY_COUNT; ++i)
+	{
+		stats.samples[i].pending = false;
+	}
+	stats.frame = 0;
+	stats.glyphPixels = 0.0f;
+	stats.gpuTotalUS = 0.0;
+	stats.glyphPixelsTotal = 0.0;
+	stats.csv = false;
+	QueryPerformanceCounter(&stats.lastFrame);
+	stats.intervalStart = stats.lastFrame;
+
+	if(csvPath != NULL)
+	{
+		if(!stats.csvFile.Open(csvPath, "w"))
+		{
+			FatalError("Failed to open CSV file: %s", csvPath);
+		}
+
+		const char* const header = "frame,frame_us,submit_us,gpu_us,glyph_pixels\n";
+		stats.csvFile.Write(header, strlen(header));
+		stats.csv = true;
+	}
+}
+
+static f64 Stats_ElapsedUS(const LARGE_INTEGER& start, const LARGE_INTEGER& end)
+{
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+
+	return (f64)(1000000 * (end.QuadPart - start.QuadPart)) / (f64)freq.QuadPart;
+}
+
+// gpuUS is negative when unavailable
+static void Stats_RecordSample(const FrameSample& sample, f32 gpuUS)
+{
+	FrameStats& stats = gl.stats;
+	stats.frameUS.push_back(sample.frameUS);
+	stats.submitUS.push_back(sample.submitUS);
+	if(gpuUS >= 0.0f)
+	{
+		stats.gpuUS.push_back(gpuUS);
+		stats.gpuTotalUS += (f64)gpuUS;
+		stats.glyphPixelsTotal += (f64)sample.glyphPixels;
+	}
+
+	if(stats.csv)
+	{
+		char line[256];
+		if(gpuUS >= 0.0f)
+		{
+			sprintf(line, "%u,%.1f,%.1f,%.1f,%.0f\n", sample.frame, sample.frameUS, sample.submitUS, gpuUS, sample.glyphPixels);
+		}
+		else
+		{
+			sprintf(line, "%u,%.1f,%.1f,,%.0f\n", sample.frame, sample.frameUS, sample.submitUS, sample.glyphPixels);
+		}
+		stats.csvFile.Write(line, strlen(line));
+	}
+}
+
+static f32 Stats_Percentile(const std::vector<f32>& sortedValues, f32 percentile)
+{
+	const size_t index = (size_t)(percentile * (f32)(sortedValues.size() - 1) + 0.5f);
+
+	return sortedValues[index];
+}
+
+static void Stats_FormatLine(char* line, const char* name, std::vector<f32>& values)
+{
+	if(values.empty())
+	{
+		sprintf(line, "%s n/a\n", name);
+		return;
+	}
+
+	std::sort(values.begin(), values.end());
+	sprintf(line, "%s min %7.1f  med %7.1f  p95 %7.1f  p99 %7.1f\n", name,
+			values[0], Stats_Percentile(values, 0.5f), Stats_Percentile(values, 0.95f), Stats_Percentile(values, 0.99f));
+}
+
+static void Stats_Report()
+{
+	FrameStats& stats = gl.stats;
+	if(stats.frameUS.empty())
+	{
+		return;
+	}
+
+	char frameLine[128];
+	char submitLine[128];
+	char gpuLine[128];
+	char pixelLine[128];
+	Stats_FormatLine(frameLine, "Frame  (us):", stats.frameUS);
+	Stats_FormatLine(submitLine, "Submit (us):", stats.submitUS);
+	Stats_FormatLine(gpuLine, "GPU    (us):", stats.gpuUS);
+	if(stats.glyphPixelsTotal > 0.0)
+	{
+		sprintf(pixelLine, "GPU: %.3f ns per glyph pixel\n", (1000.0 * stats.gpuTotalUS) / stats.glyphPixelsTotal);
+	}
+	else
+	{
+		pixelLine[0] = '\0';
+	}
+
+	PrintInfo("%s", frameLine);
+	PrintInfo("%s", submitLine);
+	PrintInfo("%s", gpuLine);
+	if(pixelLine[0] != '\0')
+	{
+		PrintInfo("%s", pixelLine);
+	}
+
+	char overlay[512];
+	sprintf(overlay, "%s%s%s%s", frameLine, submitLine, gpuLine, pixelLine);
+	Text_SetString(gl.statsBlock, overlay, 14.0f);
+	const f32 ascent = (f32)gl.font.info.ascent * 14.0f / (f32)gl.font.info.unitsPerEm;
+	Text_SetTransform(gl.statsBlock, 8.0f, (f32)sys.displayHeight - 8.0f - ascent, 1.0f);
+
+	stats.frameUS.clear();
+	stats.submitUS.clear();
+	stats.gpuUS.clear();
+	stats.gpuTotalUS = 0.0;
+	stats.glyphPixelsTotal = 0.0;
+}
+
+static void Stats_Shutdown()
+{
+	FrameStats& stats = gl.stats;
+	for(u32 i = 0; i < STATS_QUERY_COUNT; ++i)
+	{
+		// oldest first
+		const u32 slot = (stats.frame + i) % STATS_QUERY_COUNT;
+		FrameSample& sample = stats.samples[slot];
+		if(sample.pending)
+		{
+			GLuint64 elapsedNS = 0;
+			glGetQueryObjectui64v(stats.queries[slot], GL_QUERY_RESULT, &elapsedNS);
+			Stats_RecordSample(sample, (f32)((f64)elapsedNS / 1000.0));
+			sample.pending = false;
+		}
+	}
+	Stats_Report();
+
+	if(stats.csv && !stats.csvFile.Close())
+	{
+		PrintError("Failed to write the CSV file\n");
+	}
+	stats.csv = false;
+}
+
+static void Stats_BeginGlyphs()
+{
+	FrameStats& stats = gl.stats;
+	const u32 slot = stats.frame % STATS_QUERY_COUNT;
+	FrameSample& sample = stats.samples[slot];
+	if(sample.pending)
+	{
+		// this frame's query is STATS_QUERY_COUNT frames old, so this shouldn't stall
+		GLuint64 elapsedNS = 0;
+		glGetQueryObjectui64v(stats.queries[slot], GL_QUERY_RESULT, &elapsedNS);
+		Stats_RecordSample(sample, (f32)((f64)elapsedNS / 1000.0));
+		sample.pending = false;
+	}
+
+	stats.glyphPixels = 0.0f;
+	QueryPerformanceCounter(&stats.submitStart);
+	if(stats.timerQueries)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, stats.queries[slot]);
+	}
+}
+
+static void Stats_EndGlyphs()
+{
+	FrameStats& stats = gl.stats;
+	if(stats.timerQueries)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	FrameSample& sample = stats.samples[stats.frame % STATS_QUERY_COUNT];
+	sample.frame = stats.frame;
+	sample.submitUS = (f32)Stats_ElapsedUS(stats.submitStart, now);
+	sample.glyphPixels = stats.glyphPixels;
+}
+
+// the frame time is measured from the end of one frame to the end of the next
+// so it includes the buffer swap and whatever the previous frame did after this call
+static void Stats_EndFrame()
+{
+	FrameStats& stats = gl.stats;
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	FrameSample& sample = stats.samples[stats.frame % STATS_QUERY_COUNT];
+	sample.frameUS = (f32)Stats_ElapsedUS(stats.lastFrame, now);
+	if(stats.timerQueries)
+	{
+		sample.pending = true;
+	}
+	else
+	{
+		Stats_RecordSample(sample, -1.0f);
+	}
+	stats.lastFrame = now;
+	++stats.frame;
+
+	if(Stats_ElapsedUS(stats.intervalStart, now) >= (f64)STATS_INTERVAL_US)
+	{
+		Stats_Report();
+		stats.intervalStart = now;
+	}
+}
+
+static void GL_CreateOffscreenTarget(int width, int height)
+{
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+	if(width > (int)maxSize || height > (int)maxSize)
+	{
+		FatalError("The offscreen target can't be larger than %dx%d", (int)maxSize, (int)maxSize);
+	}
+
+	glGenRenderbuffers(1, &gl.offscreenRB);
+	glBindRenderbuffer(GL_RENDERBUFFER, gl.offscreenRB);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &gl.offscreenFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, gl.offscreenFBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, gl.offscreenRB);
+	const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if(status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		FatalError("Incomplete offscreen framebuffer (0x%X)", (unsigned int)status);
+	}
+	GL_CheckErrors();
+
+	// stays bound for the whole run
+	sys.displayWidth = width;
+	sys.displayHeight = height;
+}
+
+// writes an uncompressed TGA with the bottom-left origin, just like the GL read-back
+// 1 channel: the red channel as grayscale
+// 3 channels: RGB
+static bool GL_WriteOffscreenTarget(const char* outputPath, u32 channels)
+{
+	TRACE_ZONE("GL_WriteOffscreenTarget");
+
+	const u32 w = (u32)sys.displayWidth;
+	const u32 h = (u32)sys.displayHeight;
+	if(w > 0xFFFF || h > 0xFFFF)
+	{
+		PrintError("TGA images can't be larger than 65535x65535\n");
+		return false;
+	}
+
+	std::vector<u8> rgba;
+	rgba.resize((size_t)w * (size_t)h * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, (GLsizei)w, (GLsizei)h, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+	GL_CheckErrors();
+
+	const size_t pixelCount = (size_t)w * (size_t)h;
+	std::vector<u8> pixels;
+	pixels.resize(pixelCount * channels);
+	for(size_t i = 0; i < pixelCount; ++i)
+	{
+		const u8* const src = &rgba[i * 4];
+		u8* const dst = &pixels[i * channels];
+		if(channels == 1)
+		{
+			dst[0] = src[0];
+		}
+		else
+		{
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
+		}
+	}
+
+	u8 header[18] = { 0 };
+	header[2] = channels == 1 ? 3 : 2; // uncompressed grayscale or true-color
+	header[12] = (u8)(w & 0xFF);
+	header[13] = (u8)(w >> 8);
+	header[14] = (u8)(h & 0xFF);
+	header[15] = (u8)(h >> 8);
+	header[16] = (u8)(channels * 8);
+
+	File file;
+	if(!file.Open(outputPath, "wb") ||
+	   !file.Write(header, sizeof(header)) ||
+	   !file.Write(&pixels[0], pixels.size()) ||
+	   !file.Close())
+	{
+		PrintError("Failed to write output image file '%s'\n", outputPath);
+		return false;
 	}
+
+	return true;
 }
 
 static void App_Init(const char* fontPath)
 {
 	glViewport(0, 0, sys.displayWidth, sys.displayHeight);
 
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	glOrtho(0, sys.displayWidth, 0, sys.displayHeight, 0, 1);
+	// the glyph shader depends on the font's curves layout
+	Font_Load(fontPath);
 
-	if(!GL_CreateProgram(gl.program, vertexShader, fragmentShader))
+	const bool inlineCurves = (gl.font.info.flags & SLUGGISH_FLAG_INLINE_CURVES) != 0;
+	if(!GL_CreateProgram(gl.program, vertexShader, fragmentShader, inlineCurves ? "#define INLINE_CURVES 1\n" : "#define INLINE_CURVES 0\n"))
 	{
 		FatalError("Failed to build shader");
 	}
 
-	Font_Load(fontPath);
+	if(!GL_CreateProgram(gl.solidProgram, solidVertexShader, solidFragmentShader))
+	{
+		FatalError("Failed to build shader");
+	}
+
+	// uniforms that never change only get set once
+	GL_BindProgram(gl.program);
+	glUniform1i(glGetUniformLocation(gl.program.p, "curvesTex"), 0);
+	glUniform1i(glGetUniformLocation(gl.program.p, "bandsTex"), 1);
+	glUniform1i(glGetUniformLocation(gl.program.p, "glyphsTex"), 2);
+	glUniform2f(glGetUniformLocation(gl.program.p, "displaySize"), (f32)sys.displayWidth, (f32)sys.displayHeight);
+	gl.glyphTransformLoc = glGetUniformLocation(gl.program.p, "glyphTransform");
+	gl.solidRectLoc = glGetUniformLocation(gl.solidProgram.p, "rect");
+	gl.solidColorLoc = glGetUniformLocation(gl.solidProgram.p, "color");
+	GL_UnbindProgram();
+	GL_CheckErrors();
 
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+	// triangle strip order
 	const float vertices[] =
 	{
 		-1.0f, -1.0f, 0.0f, 0.0f,
+		1.0f, -1.0f, 1.0f, 0.0f,
 		-1.0f, 1.0f, 0.0f, 1.0f,
-		1.0f, 1.0f, 1.0f, 1.0f,
-		1.0f, -1.0f, 1.0f, 0.0f
+		1.0f, 1.0f, 1.0f, 1.0f
 	};
 
-	glGenVertexArrays(1, &gl.quadVAO);
 	glGenBuffers(1, &gl.quadVBO);
-	glBindVertexArray(gl.quadVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, gl.quadVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	GL_CheckErrors();
 	
-	glGenBuffers(1, &gl.scaleBiasVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, gl.scaleBiasVBO);
-	glBufferData(GL_ARRAY_BUFFER, 16 * MAX_GLYPHS, NULL, GL_DYNAMIC_DRAW);
-	GL_CheckErrors();
-	
-	glGenBuffers(1, &gl.glyphBandScaleVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, gl.glyphBandScaleVBO);
-	glBufferData(GL_ARRAY_BUFFER, 16 * MAX_GLYPHS, NULL, GL_DYNAMIC_DRAW);
-	GL_CheckErrors();
-	
-	glGenBuffers(1, &gl.bandMaxTexCoordsVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, gl.bandMaxTexCoordsVBO);
-	glBufferData(GL_ARRAY_BUFFER, 16 * MAX_GLYPHS, NULL, GL_DYNAMIC_DRAW);
-	GL_CheckErrors();
+	// the instance attribute offsets get updated by GL_RenderAllGlyphs for every draw
+	GL_CreateInstanceRing();
+	GL_CreateGlyphVAO(&gl.quadVAO, gl.ring.vbo);
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	
-	// float2 positions
+	glGenVertexArrays(1, &gl.solidVAO);
+	glBindVertexArray(gl.solidVAO);
 	glEnableVertexAttribArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, gl.quadVBO);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-
-	// float2 texture coordinates
-	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, gl.quadVBO);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-	
-	// float4 vertex scale and bias
-	glEnableVertexAttribArray(2);
-	glBindBuffer(GL_ARRAY_BUFFER, gl.scaleBiasVBO);
-	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
-	GL_CheckErrors();
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glVertexAttribDivisor(2, 1);
-	GL_CheckErrors();
-	
-	// float4 glyph scale and bands scale
-	glEnableVertexAttribArray(3);
-	glBindBuffer(GL_ARRAY_BUFFER, gl.glyphBandScaleVBO);
-	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
-	GL_CheckErrors();
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glVertexAttribDivisor(3, 1);
-	GL_CheckErrors();
-	
-	// uint4 band max and tex coords
-	glEnableVertexAttribArray(4);
-	glBindBuffer(GL_ARRAY_BUFFER, gl.bandMaxTexCoordsVBO);
-	glVertexAttribIPointer(4, 4, GL_UNSIGNED_INT, 0, (void*)0);
-	GL_CheckErrors();
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glVertexAttribDivisor(4, 1);
+	glBindVertexArray(0);
 	GL_CheckErrors();
+
+	Text_CreateBlock(gl.mainBlock);
+	gl.mainBlockValid = false;
+
+	Text_CreateBlock(gl.statsBlock);
+	gl.statsBlock.fixed = true;
+
+	Text_CreateBlock(gl.docBlock);
+	gl.drawDoc = false;
+	if(g_docPath != NULL)
+	{
+		if(!Text_LoadDocument(gl.docBlock, g_docPath, g_docPixelsPerEm))
+		{
+			FatalError("Failed to load the document");
+		}
+		gl.drawDoc = true;
+	}
 	
 	gl.zoom = 1.0f;
 	gl.zoomOffsetX = 0.0f;
@@ -630,66 +1482,94 @@ static void App_Init(const char* fontPath)
 
 static void App_Frame()
 {
+	TRACE_ZONE("App_Frame");
+
+	if(sys.coverageScene)
+	{
+		// the color we read back is the coverage value
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		Stats_BeginGlyphs();
+		GL_RenderGlyph(g_text[0], 0.0f, 0.0f, (f32)sys.displayWidth, (f32)sys.displayHeight);
+		GL_RenderAllGlyphs(gl.program);
+		Stats_EndGlyphs();
+		Stats_EndFrame();
+		return;
+	}
+
 	glClearColor(0.0f, 0.25f, 0.25f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 
 #if 1
-	glColor4f(1.0f, 1.0f, 0.25f, 0.125f);
 	{
-		glBegin(GL_QUADS);
-		glVertex2f(0.0f, 0.0f);
-		glVertex2f(0.0f, (GLfloat)sys.displayHeight);
-		glVertex2f((GLfloat)sys.displayWidth, (GLfloat)sys.displayHeight);
-		glVertex2f((GLfloat)sys.displayWidth, 0.0f);
+		// the background shows where the window's rectangle ends up with the current zoom and pan
+		const f32 dw = (f32)sys.displayWidth;
+		const f32 dh = (f32)sys.displayHeight;
+		const f32 x1 = gl.zoomOffsetX;
+		const f32 y1 = gl.zoomOffsetY;
+		const f32 x2 = gl.zoomOffsetX + gl.zoom * dw;
+		const f32 y2 = gl.zoomOffsetY + gl.zoom * dh;
+		GL_BindProgram(gl.solidProgram);
+		glUniform4f(gl.solidRectLoc, 2.0f * (x1 / dw) - 1.0f, 2.0f * (y1 / dh) - 1.0f, 2.0f * (x2 / dw) - 1.0f, 2.0f * (y2 / dh) - 1.0f);
+		glUniform4f(gl.solidColorLoc, 1.0f, 1.0f, 0.25f, 0.125f);
+		glBindVertexArray(gl.solidVAO);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		glBindVertexArray(0);
+		GL_UnbindProgram();
 	}
-	glEnd();
 #endif
 
-	if(gl.drawText)
+	Stats_BeginGlyphs();
+
+	if(gl.drawText && gl.drawDoc)
+	{
+		Text_DrawBlock(gl.docBlock);
+	}
+	else if(gl.drawText)
 	{
 		const f32 top = (f32)sys.displayHeight;
 		const f32 s = 300.0f;
 		const f32 d = 25.0f;
 		f32 y = top - s - d;
 		f32 x = d;
-		GL_RenderGlyph(g_text[0], x, y, s, s); x += d + s;
-		GL_RenderGlyph(g_text[1], x, y, s, s); x += d + s;
-		GL_RenderGlyph(g_text[2], x, y, s, s); x = d; y -= d + s;
-		GL_RenderGlyph(g_text[3], x, y, s, s); x += d + s;
-		GL_RenderGlyph(g_text[4], x, y, s, s); x += d + s;
-		GL_RenderGlyph(g_text[5], x, y, s, s);
-		GL_RenderAllGlyphs(gl.program);
+		TextBlock& block = gl.mainBlock;
+		if(!gl.mainBlockValid)
+		{
+			Text_Clear(block);
+			Text_AddGlyph(block, g_text[0], x, y, s, s); x += d + s;
+			Text_AddGlyph(block, g_text[1], x, y, s, s); x += d + s;
+			Text_AddGlyph(block, g_text[2], x, y, s, s); x = d; y -= d + s;
+			Text_AddGlyph(block, g_text[3], x, y, s, s); x += d + s;
+			Text_AddGlyph(block, g_text[4], x, y, s, s); x += d + s;
+			Text_AddGlyph(block, g_text[5], x, y, s, s);
+			gl.mainBlockValid = true;
+		}
+		Text_DrawBlock(block);
 	}
 
-#if 1
-	// @TODO: render on screen
-	static LARGE_INTEGER lastFrame = { 0 };
-	static bool firstFrame = true;
-	if(firstFrame)
-	{
-		firstFrame = false;
-		QueryPerformanceCounter(&lastFrame);
-		return;
-	}
-	LARGE_INTEGER now, freq;
-	QueryPerformanceCounter(&now);
-	QueryPerformanceFrequency(&freq);
-	const u64 elapsedUS = (u64)(1000000 * (now.QuadPart - lastFrame.QuadPart) / freq.QuadPart);
-	const u32 maxFrameCount = (u32)(sizeof(sys.frameDurationsUS) / sizeof(sys.frameDurationsUS[0]));
-	sys.frameDurationsUS[sys.frameCount++] = elapsedUS;
-	lastFrame.QuadPart = now.QuadPart;
-	if(sys.frameCount == maxFrameCount)
+	if(gl.stressGlyphCount > 0)
 	{
-		u64 frameTimeUS = 0;
-		for(u32 i = 0; i < sys.frameCount; ++i)
+		// a grid of tiny glyphs covering the whole window
+		const u32 columns = (u32)sqrtf((f32)gl.stressGlyphCount * (f32)sys.displayWidth / (f32)sys.displayHeight) + 1;
+		const f32 s = (f32)sys.displayWidth / (f32)columns;
+		for(u32 i = 0; i < gl.stressGlyphCount; ++i)
 		{
-			frameTimeUS += sys.frameDurationsUS[i];
+			const u32 codePoint = gl.font.codePoints[i % (u32)gl.font.codePoints.size()].codePoint;
+			const f32 x = (f32)(i % columns) * s;
+			const f32 y = (f32)sys.displayHeight - (f32)(i / columns + 1) * s;
+			GL_RenderGlyph(codePoint, x, y, s, s);
 		}
-		frameTimeUS /= (u64)sys.frameCount;
-		PrintInfo("Frame time: %u us\n", (unsigned int)frameTimeUS);
-		sys.frameCount = 0;
+		GL_RenderAllGlyphs(gl.program);
 	}
-#endif
+
+	Stats_EndGlyphs();
+
+	if(gl.drawStats)
+	{
+		Text_DrawBlock(gl.statsBlock);
+	}
+
+	Stats_EndFrame();
 }
 
 static void Sys_KeyDown(const SDL_KeyboardEvent& event)
@@ -704,18 +1584,25 @@ static void Sys_KeyDown(const SDL_KeyboardEvent& event)
 			gl.zoom = 1.0f;
 			gl.zoomOffsetX = 0.0f;
 			gl.zoomOffsetY = 0.0f;
-			glViewport(0, 0, sys.displayWidth, sys.displayHeight);
 			break;
 
 		case SDLK_d:
 		case SDLK_z:
 			PrintInfo("Zoom: %g - X: %g - Y: %g\n", gl.zoom, gl.zoomOffsetX, gl.zoomOffsetY);
+			if(gl.drawDoc)
+			{
+				PrintInfo("Document: %u / %u glyphs visible\n", gl.docBlock.visibleGlyphCount, gl.docBlock.glyphCount);
+			}
 			break;
 
 		case SDLK_f:
 			gl.drawText = !gl.drawText;
 			break;
 
+		case SDLK_t:
+			gl.drawStats = !gl.drawStats;
+			break;
+
 		default:
 			break;
 	}
@@ -732,7 +1619,6 @@ static void Sys_Motion(const SDL_MouseMotionEvent& event)
 		gl.zoomOffsetX += event.xrel;
 		gl.zoomOffsetY -= event.yrel;
 		Sys_ClampZoomOffsets();
-		glViewport((GLsizei)gl.zoomOffsetX, (GLsizei)gl.zoomOffsetY, (GLsizei)(gl.zoom * sys.displayWidth), (GLsizei)(gl.zoom * sys.displayHeight));
 	}
 
 	gl.cursorX = event.x;
@@ -768,7 +1654,6 @@ static void Sys_Wheel(const SDL_MouseWheelEvent& event, int cx, int cy)
 	gl.zoomOffsetX += x - x1;
 	gl.zoomOffsetY += y - y1;
 	Sys_ClampZoomOffsets();
-	glViewport((GLsizei)gl.zoomOffsetX, (GLsizei)gl.zoomOffsetY, (GLsizei)(gl.zoom * sys.displayWidth), (GLsizei)(gl.zoom * sys.displayHeight));
 }
 
 static void Sys_HandleEvent(const SDL_Event& event)
@@ -802,25 +1687,117 @@ int main(int argc, char** argv)
 	{
 		printf("Renders up to 6 glyphs of a Sluggish font to a window using OpenGL\n");
 		printf("\n");
-		printf("%s <input%s> [text]\n", GetExecutableFileName(argv[0]), SLUGGISH_EXTENSION_NAME);
+		printf("%s <input%s> [text] [-stress=count] [-doc=file.txt] [-docsize=ppem] [-headless=WxH] [-frames=N] [-output=file.tga] [-coverage] [-csv=file.csv] [-stats] [-trace=file.json]\n", GetExecutableFileName(argv[0]), SLUGGISH_EXTENSION_NAME);
+		printf("\n");
+		printf("-stress=count  Also draws 'count' small glyphs every frame\n");
+		printf("-doc=path      Lays out a text file instead of the glyphs, pan and zoom to browse it\n");
+		printf("-docsize=ppem  Pixels per em of the document's text (default: 16)\n");
+		printf("-headless=WxH  Renders to a WxH offscreen target with a hidden window and exits\n");
+		printf("               The GL context still comes from SDL: a display and a video driver are required,\n");
+		printf("               software GL implementations like Mesa's llvmpipe are accepted\n");
+		printf("-frames=N      Number of frames to render in headless mode (default: 1)\n");
+		printf("-output=path   Writes the last headless frame to a TGA file\n");
+		printf("-coverage      Headless only: renders the first glyph stretched over the whole target\n");
+		printf("               and writes the coverage as grayscale, like 'fontrender -stretch'\n");
+		printf("-csv=path      Logs the timings of every frame to a CSV file\n");
+		printf("-stats         Shows the timings on screen, press T to toggle\n");
+		printf("-trace=path    Writes the CPU timings of loading and of every frame to a Chrome\n");
+		printf("               trace file (chrome://tracing or ui.perfetto.dev)\n");
+		printf("               Only in debug builds or when premake got the --trace option\n");
 		return 1337;
 	}
 
 	strcpy(g_text, "@#?{B~");
-	if(argc >= 3 && argv[2][0] != '\0')
+	if(argc >= 3 && argv[2][0] != '\0' && argv[2][0] != '-')
 	{
 		strncpy(g_text, argv[2], sizeof(g_text));
 	}
 
+	gl.stressGlyphCount = 0;
+	sys.headless = false;
+	sys.coverageScene = false;
+	sys.headlessFrames = 1;
+	sys.outputPath = NULL;
+	int headlessWidth = 0;
+	int headlessHeight = 0;
+	const char* csvPath = NULL;
+	gl.drawStats = false;
+	for(int i = 2; i < argc; ++i)
+	{
+		const char* const arg = argv[i];
+		if(strstr(arg, "-stress=") == arg)
+		{
+			if(sscanf(arg + 8, "%u", &gl.stressGlyphCount) != 1)
+			{
+				FatalError("Invalid stress glyph count: %s", arg);
+			}
+		}
+		else if(strstr(arg, "-doc=") == arg)
+		{
+			g_docPath = arg + 5;
+		}
+		else if(strstr(arg, "-docsize=") == arg)
+		{
+			if(sscanf(arg + 9, "%f", &g_docPixelsPerEm) != 1 || g_docPixelsPerEm <= 0.0f)
+			{
+				FatalError("Invalid document size: %s", arg);
+			}
+		}
+		else if(strstr(arg, "-headless=") == arg)
+		{
+			if(sscanf(arg + 10, "%dx%d", &headlessWidth, &headlessHeight) != 2 || headlessWidth <= 0 || headlessHeight <= 0)
+			{
+				FatalError("Invalid headless resolution: %s", arg);
+			}
+			sys.headless = true;
+		}
+		else if(strstr(arg, "-frames=") == arg)
+		{
+			if(sscanf(arg + 8, "%u", &sys.headlessFrames) != 1 || sys.headlessFrames == 0)
+			{
+				FatalError("Invalid frame count: %s", arg);
+			}
+		}
+		else if(strstr(arg, "-output=") == arg)
+		{
+			sys.outputPath = arg + 8;
+		}
+		else if(strcmp(arg, "-coverage") == 0)
+		{
+			sys.coverageScene = true;
+		}
+		else if(strstr(arg, "-csv=") == arg)
+		{
+			csvPath = arg + 5;
+		}
+		else if(strcmp(arg, "-stats") == 0)
+		{
+			gl.drawStats = true;
+		}
+		else if(strstr(arg, "-trace=") == arg)
+		{
+			// the trace gets written when we exit
+			Trace_Open(arg + 7);
+		}
+	}
+
+	if(sys.coverageScene && !sys.headless)
+	{
+		FatalError("-coverage requires -headless");
+	}
+
 	if(SDL_Init(SDL_INIT_VIDEO) != 0)
 	{
 		FatalError("SDL_Init failed: %s", SDL_GetError());
 	}
 
-	sys.window = SDL_CreateWindow("Sluggish", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 1024, 768, SDL_WINDOW_OPENGL);
+	// in headless mode, the window is only there to get a GL context
+	// SDL 2.0.8 has no offscreen video driver, so that still takes a display
+	const Uint32 windowFlags = sys.headless ? (SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN) : SDL_WINDOW_OPENGL;
+	sys.window = SDL_CreateWindow("Sluggish", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 1024, 768, windowFlags);
 	if(sys.window == NULL)
 	{
-		FatalError("SDL_CreateWindow failed: %s", SDL_GetError());
+		FatalError("SDL_CreateWindow failed%s: %s", sys.headless ? " (headless mode still needs a display)" : "", SDL_GetError());
 	}
 	SDL_GetWindowSize(sys.window, &sys.displayWidth, &sys.displayHeight);
 
@@ -832,23 +1809,63 @@ int main(int argc, char** argv)
 	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 0);
 	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 0);
-	SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1);
+	// headless runs can go through software GL
+	if(!sys.headless)
+	{
+		SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1);
+	}
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_COMPATIBILITY);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
 	sys.glContext = SDL_GL_CreateContext(sys.window);
 	if(sys.glContext == NULL)
 	{
 		FatalError("SDL_GL_CreateContext failed: %s", SDL_GetError());
 	}
 
+	// without this, GLEW doesn't load the entry points that core contexts don't advertise as extensions
+	glewExperimental = GL_TRUE;
 	const GLenum glewCode = glewInit();
 	if(glewCode != GLEW_OK)
 	{
 		FatalError("glewInit failed: %s", glewGetErrorString(glewCode));
 	}
 
+	// glewInit calls glGetString(GL_EXTENSIONS), which is invalid in core contexts
+	glGetError();
+
+	if(sys.headless)
+	{
+		GL_CreateOffscreenTarget(headlessWidth, headlessHeight);
+	}
+
 	App_Init(argv[1]);
+	Stats_Init(csvPath);
+
+	int exitCode = 0;
+	if(sys.headless)
+	{
+		LARGE_INTEGER start, end, freq;
+		QueryPerformanceCounter(&start);
+		for(u32 i = 0; i < sys.headlessFrames; ++i)
+		{
+			App_Frame();
+		}
+		{
+			TRACE_ZONE("glFinish");
+			glFinish();
+		}
+		QueryPerformanceCounter(&end);
+		QueryPerformanceFrequency(&freq);
+		const f64 durationMS = (f64)(1000 * (end.QuadPart - start.QuadPart)) / (f64)freq.QuadPart;
+		PrintInfo("Headless: %u frames in %.3f ms (%.3f ms per frame)\n", sys.headlessFrames, durationMS, durationMS / (f64)sys.headlessFrames);
+
+		if(sys.outputPath != NULL && !GL_WriteOffscreenTarget(sys.outputPath, sys.coverageScene ? 1 : 3))
+		{
+			exitCode = 1;
+		}
+		sys.quit = true;
+	}
 
 	while(!sys.quit)
 	{
@@ -860,9 +1877,14 @@ int main(int argc, char** argv)
 
 		App_Frame();
 
-		SDL_GL_SwapWindow(sys.window);
+		{
+			TRACE_ZONE("SDL_GL_SwapWindow");
+			SDL_GL_SwapWindow(sys.window);
+		}
 	}
 
+	Stats_Shutdown();
+
 	if(sys.window)
 	{
 		SDL_DestroyWindow(sys.window);
@@ -870,5 +1892,5 @@ int main(int argc, char** argv)
 
 	SDL_Quit();
 
-	return 0;
+	return exitCode;
 }
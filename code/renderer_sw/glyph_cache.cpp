@@ -0,0 +1,136 @@
+#include "glyph_cache.hpp"
+
+#include <stdio.h>
+
+
+// rough estimate of the bookkeeping cost of an entry (list node + hash map node)
+// so that a budget filled with tiny masks doesn't end up way bigger than requested
+#define ENTRY_OVERHEAD_BYTES (sizeof(GlyphCache::Entry) + 64)
+
+
+GlyphCache::GlyphCache() : maxBytes(0), usedBytes(0)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+void GlyphCache::SetBudget(uptr bytes)
+{
+	maxBytes = bytes;
+	if(usedBytes > maxBytes)
+	{
+		Clear();
+	}
+}
+
+bool GlyphCache::IsEnabled() const
+{
+	return maxBytes > 0;
+}
+
+const u8* GlyphCache::Find(u64 key, u32 bytes)
+{
+	if(maxBytes == 0 || key == 0)
+	{
+		return NULL;
+	}
+
+	const auto it = lookup.find(key);
+	if(it == lookup.end() || it->second->data.size() != (size_t)bytes)
+	{
+		++stats.misses;
+		return NULL;
+	}
+
+	// move to the front of the list
+	entries.splice(entries.begin(), entries, it->second);
+	++stats.hits;
+
+	return &it->second->data[0];
+}
+
+void GlyphCache::Insert(u64 key, const u8* data, u32 bytes)
+{
+	if(maxBytes == 0 || key == 0)
+	{
+		return;
+	}
+
+	const uptr entryBytes = (uptr)bytes + ENTRY_OVERHEAD_BYTES;
+	if(entryBytes > maxBytes)
+	{
+		++stats.rejections;
+		return;
+	}
+
+	const auto it = lookup.find(key);
+	if(it != lookup.end())
+	{
+		usedBytes -= (uptr)it->second->data.size() + ENTRY_OVERHEAD_BYTES;
+		entries.erase(it->second);
+		lookup.erase(it);
+	}
+
+	// evict the least recently used entries until the new one fits
+	while(usedBytes + entryBytes > maxBytes && !entries.empty())
+	{
+		const Entry& lru = entries.back();
+		usedBytes -= (uptr)lru.data.size() + ENTRY_OVERHEAD_BYTES;
+		lookup.erase(lru.key);
+		entries.pop_back();
+		++stats.evictions;
+	}
+
+	entries.push_front(Entry());
+	Entry& entry = entries.front();
+	entry.key = key;
+	entry.data.assign(data, data + bytes);
+	lookup[key] = entries.begin();
+	usedBytes += entryBytes;
+	++stats.insertions;
+}
+
+void GlyphCache::Clear()
+{
+	entries.clear();
+	lookup.clear();
+	usedBytes = 0;
+}
+
+void GlyphCache::PrintStats() const
+{
+	const u64 lookups = stats.hits + stats.misses;
+	const f64 hitRate = lookups > 0 ? (100.0 * (f64)stats.hits / (f64)lookups) : 0.0;
+	PrintInfo("Glyph cache: %llu hits, %llu misses (%.1f%% hit rate)\n",
+			  (unsigned long long)stats.hits, (unsigned long long)stats.misses, hitRate);
+	PrintInfo("Glyph cache: %llu insertions, %llu evictions, %llu rejections\n",
+			  (unsigned long long)stats.insertions, (unsigned long long)stats.evictions, (unsigned long long)stats.rejections);
+	PrintInfo("Glyph cache: %u entries, %.2f / %.2f MB used\n",
+			  (unsigned int)entries.size(), (f64)usedBytes / (1024.0 * 1024.0), (f64)maxBytes / (1024.0 * 1024.0));
+}
+
+u64 GlyphCache::MakeKey(u32 codePoint, u32 width, u32 height, u32 subpixelX, u32 subpixelY, bool stretched, u32 variant)
+{
+	// 21 bits: code point
+	// 16 bits: width
+	// 16 bits: height
+	//  2 bits: sub-pixel X
+	//  2 bits: sub-pixel Y
+	//  1 bit:  stretched
+	//  2 bits: variant
+	// 0 is reserved for things we can't cache
+	if(codePoint > 0x10FFFF || width > 0xFFFF || height > 0xFFFF ||
+	   subpixelX >= GLYPH_CACHE_SUBPIXEL_STEPS || subpixelY >= GLYPH_CACHE_SUBPIXEL_STEPS || variant > 3)
+	{
+		return 0;
+	}
+
+	return
+		((u64)codePoint) |
+		((u64)width << 21) |
+		((u64)height << 37) |
+		((u64)subpixelX << 53) |
+		((u64)subpixelY << 55) |
+		((u64)(stretched ? 1 : 0) << 57) |
+		((u64)variant << 58) |
+		((u64)1 << 62);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+
+#include "../shared.hpp"
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+
+// number of sub-pixel positions per axis the glyph origin gets snapped to
+// can't be more than 4
+#define GLYPH_CACHE_SUBPIXEL_STEPS 4
+
+struct GlyphCacheStats
+{
+	u64 hits;
+	u64 misses;
+	u64 insertions;
+	u64 evictions;
+	u64 rejections; // entries bigger than the whole budget
+};
+
+// keeps rendered coverage masks around so that we never trace the same glyph twice
+// the least recently used masks get evicted first when we run out of budget
+struct GlyphCache
+{
+	GlyphCache();
+
+	void SetBudget(uptr maxBytes);
+	bool IsEnabled() const;
+
+	// returns NULL on a miss
+	// on a hit, the entry becomes the most recently used one
+	const u8* Find(u64 key, u32 bytes);
+	void Insert(u64 key, const u8* data, u32 bytes);
+	void Clear();
+	void PrintStats() const;
+
+	// variant: anything else that changes the output in [0,3], e.g. the anti-aliasing mode
+	static u64 MakeKey(u32 codePoint, u32 width, u32 height, u32 subpixelX, u32 subpixelY, bool stretched, u32 variant);
+
+	struct Entry
+	{
+		u64 key;
+		std::vector<u8> data;
+	};
+
+	typedef std::list<Entry> EntryList;
+
+	EntryList entries; // front is the most recently used
+	std::unordered_map<u64, EntryList::iterator> lookup;
+	uptr maxBytes;
+	uptr usedBytes;
+	GlyphCacheStats stats;
+};
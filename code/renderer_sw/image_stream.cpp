@@ -0,0 +1,127 @@
+#include "image_stream.hpp"
+#include "stb_image_write.h"
+#include "../sluggish/trace.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+
+static const char* const formatNames[IMAGE_FORMAT_COUNT] =
+{
+	"tga",
+	"pgm",
+	"raw"
+};
+
+
+const char* GetImageFormatExtension(ImageFormat format)
+{
+	return formatNames[format];
+}
+
+bool ParseImageFormat(const char* name, ImageFormat* format)
+{
+	for(int i = 0; i < IMAGE_FORMAT_COUNT; ++i)
+	{
+		if(strcmp(name, formatNames[i]) == 0)
+		{
+			*format = (ImageFormat)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+u32 GetImageHeader(u8* header, ImageFormat format, u32 w, u32 h)
+{
+	if(format == IMAGE_FORMAT_TGA)
+	{
+		// uncompressed grayscale with the origin at the top-left corner
+		memset(header, 0, 18);
+		header[2] = 3;
+		header[12] = (u8)(w & 0xFF);
+		header[13] = (u8)(w >> 8);
+		header[14] = (u8)(h & 0xFF);
+		header[15] = (u8)(h >> 8);
+		header[16] = 8;
+		header[17] = 0x20;
+		return 18;
+	}
+
+	if(format == IMAGE_FORMAT_PGM)
+	{
+		return (u32)sprintf((char*)header, "P5\n%u %u\n255\n", w, h);
+	}
+
+	return 0;
+}
+
+ImageStream::ImageStream() : width(0), height(0), rowsWritten(0)
+{
+}
+
+bool ImageStream::Open(const char* filePath, ImageFormat format, u32 w, u32 h)
+{
+	if(format == IMAGE_FORMAT_TGA && (w > 0xFFFF || h > 0xFFFF))
+	{
+		PrintError("Images bigger than 65535x65535 can't be stored as .tga: %s\n", filePath);
+		return false;
+	}
+
+	if(!file.Open(filePath, "wb"))
+	{
+		return false;
+	}
+
+	width = w;
+	height = h;
+	rowsWritten = 0;
+
+	u8 header[IMAGE_HEADER_MAX_BYTES];
+	const u32 headerBytes = GetImageHeader(header, format, w, h);
+
+	return headerBytes == 0 || file.Write(header, (size_t)headerBytes);
+}
+
+bool ImageStream::WriteRows(const u8* rows, u32 rowCount)
+{
+	TRACE_ZONE("ImageStream::WriteRows");
+
+	if(rowsWritten + rowCount > height)
+	{
+		return false;
+	}
+
+	rowsWritten += rowCount;
+
+	return file.Write(rows, (size_t)width * (size_t)rowCount);
+}
+
+bool ImageStream::Close()
+{
+	const bool complete = rowsWritten == height;
+
+	return file.Close() && complete;
+}
+
+bool WriteImage(const char* filePath, ImageFormat format, u32 w, u32 h, const u8* data)
+{
+	TRACE_ZONE("WriteImage");
+
+	if(format == IMAGE_FORMAT_TGA)
+	{
+		// RLE-compressed
+		return stbi_write_tga(filePath, w, h, 1, data) != 0;
+	}
+
+	ImageStream stream;
+	if(!stream.Open(filePath, format, w, h))
+	{
+		return false;
+	}
+
+	const bool success = stream.WriteRows(data, h);
+
+	return stream.Close() && success;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+
+#include "../shared.hpp"
+
+
+enum ImageFormat
+{
+	IMAGE_FORMAT_TGA,
+	IMAGE_FORMAT_PGM,
+	IMAGE_FORMAT_RAW, // 8-bit rows without any header
+	IMAGE_FORMAT_COUNT
+};
+
+const char* GetImageFormatExtension(ImageFormat format);
+bool ParseImageFormat(const char* name, ImageFormat* format);
+
+// the biggest header GetImageHeader can write
+#define IMAGE_HEADER_MAX_BYTES 32
+
+// writes the header of an uncompressed 8-bit image, top row first
+// returns the header's size in bytes
+u32 GetImageHeader(u8* header, ImageFormat format, u32 w, u32 h);
+
+// writes an uncompressed 8-bit image a few rows at a time, top row first
+// only the rows passed to WriteRows need to be in memory
+struct ImageStream
+{
+	ImageStream();
+
+	bool Open(const char* filePath, ImageFormat format, u32 w, u32 h);
+	bool WriteRows(const u8* rows, u32 rowCount);
+	bool Close(); // fails if not all rows were written
+
+	File file;
+	u32 width;
+	u32 height;
+	u32 rowsWritten;
+};
+
+// writes a whole image that's already in memory, top row first
+bool WriteImage(const char* filePath, ImageFormat format, u32 w, u32 h, const u8* data);
@@ -0,0 +1,136 @@
+#include "image_writer.hpp"
+#include "../sluggish/trace.hpp"
+
+
+ImageWriter::ImageWriter() : quit(false)
+{
+}
+
+ImageWriter::~ImageWriter()
+{
+	Finish();
+}
+
+bool ImageWriter::Init(u32 queueDepth, uptr bufferBytes)
+{
+	// one more buffer than the queue can hold so that we can keep rendering while the queue is full
+	const u32 bufferCount = queueDepth + 1;
+	for(u32 i = 0; i < bufferCount; ++i)
+	{
+		Buffer buffer;
+		if(!AllocBuffer(buffer, bufferBytes))
+		{
+			PrintError("Failed to allocate image buffer %u of %u\n", i + 1, bufferCount);
+			Finish();
+			return false;
+		}
+
+		pool.push_back(buffer);
+		freeBuffers.push_back((u8*)buffer.buffer);
+	}
+
+	quit = false;
+	thread = std::thread(&ImageWriter::WriterThread, this);
+
+	return true;
+}
+
+u8* ImageWriter::AcquireBuffer()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	bufferAvailable.wait(lock, [this] { return !freeBuffers.empty(); });
+
+	u8* const buffer = freeBuffers.back();
+	freeBuffers.pop_back();
+
+	return buffer;
+}
+
+void ImageWriter::ReleaseBuffer(u8* buffer)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		freeBuffers.push_back(buffer);
+	}
+	bufferAvailable.notify_one();
+}
+
+void ImageWriter::Submit(u8* buffer, const char* outputPath, ImageFormat format, u32 w, u32 h)
+{
+	Job job;
+	job.buffer = buffer;
+	job.outputPath = outputPath;
+	job.format = format;
+	job.width = w;
+	job.height = h;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(job);
+	}
+	jobAvailable.notify_one();
+}
+
+u32 ImageWriter::Finish()
+{
+	if(thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		jobAvailable.notify_one();
+		thread.join();
+	}
+
+	for(auto& buffer : pool)
+	{
+		FreeBuffer(buffer);
+	}
+	pool.clear();
+	freeBuffers.clear();
+
+	for(const auto& path : failedPaths)
+	{
+		PrintError("Failed to write output image file '%s'\n", path.c_str());
+	}
+
+	const u32 failureCount = (u32)failedPaths.size();
+	failedPaths.clear();
+
+	return failureCount;
+}
+
+void ImageWriter::WriterThread()
+{
+	TRACE_THREAD_NAME("image writer");
+
+	for(;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAvailable.wait(lock, [this] { return quit || !jobs.empty(); });
+			if(jobs.empty())
+			{
+				// we only leave once everything submitted has been written
+				break;
+			}
+
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		const bool success = WriteImage(job.outputPath.c_str(), job.format, job.width, job.height, job.buffer);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(!success)
+			{
+				failedPaths.push_back(job.outputPath);
+			}
+			freeBuffers.push_back(job.buffer);
+		}
+		bufferAvailable.notify_one();
+	}
+}
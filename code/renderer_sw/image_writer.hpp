@@ -0,0 +1,54 @@
+#pragma once
+
+
+#include "image_stream.hpp"
+#include "../shared.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// encodes and writes images on a background thread
+// - images are written in submission order
+// - the image buffers come from a fixed pool: when they're all in flight,
+//   AcquireBuffer blocks until the writer is done with one of them
+// - failures are collected and reported in submission order by Finish
+struct ImageWriter
+{
+	ImageWriter();
+	~ImageWriter();
+
+	bool Init(u32 queueDepth, uptr bufferBytes);
+	u8* AcquireBuffer();
+	void ReleaseBuffer(u8* buffer); // for buffers that never got submitted
+	void Submit(u8* buffer, const char* outputPath, ImageFormat format, u32 w, u32 h);
+
+	// waits for all pending writes and frees the pool
+	// returns the number of images that failed to be written
+	u32 Finish();
+
+	struct Job
+	{
+		u8* buffer;
+		std::string outputPath;
+		ImageFormat format;
+		u32 width;
+		u32 height;
+	};
+
+	void WriterThread();
+
+	std::vector<Buffer> pool;
+	std::vector<u8*> freeBuffers;
+	std::deque<Job> jobs;
+	std::vector<std::string> failedPaths;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable bufferAvailable;
+	std::thread thread;
+	bool quit;
+};
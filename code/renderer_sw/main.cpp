@@ -1,319 +1,443 @@
-﻿#include "stb_image_write.h"
+﻿#include "glyph_cache.hpp"
+#include "shared_glyph_cache.hpp"
+#include "image_writer.hpp"
+#include "image_stream.hpp"
+#include "skyline_packer.hpp"
+#include "render_server.hpp"
+#include "../sluggish/rasterizer.hpp"
+#include "../sluggish/trace.hpp"
 #include "../shared.hpp"
 
 #include <Windows.h>
+#include <io.h>
+#include <fcntl.h>
 #include <math.h>
 #include <ctype.h>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 
-#define BANDS_TAG_1		0xAB
-#define BANDS_TAG_2		0xABAB
-#define CURVES_TAG_1	0xCD
-#define CURVES_TAG_4	0xCDCDCDCD
+#define ATLAS_HEADER_DATA	"SLUGATLS"
+#define ATLAS_HEADER_LEN	8
+#define ATLAS_MAX_SIZE		16384
 
+#define STREAM_STRIP_BYTES	(4 << 20)
 
-#pragma pack(push, 1)
 
-struct float2
-{
-	f32 x, y;
-};
+/*
+Atlas metrics file format (.atlas)
+
+SLUGATLS (8 bytes)
+atlas width (u32)
+atlas height (u32)
+AtlasFontInfo
+# glyphs (u32)
+array of AtlasGlyph, sorted by code point
+*/
 
-struct float4
+
+#pragma pack(push, 1)
+
+// all values are in pixels
+struct AtlasFontInfo
 {
-	f32 x, y, z, w;
+	f32 pixelsPerEm;
+	f32 ascent;
+	f32 descent;
+	f32 lineGap;
 };
 
-struct ushort2
+// x, y, width and height are in pixels with the origin at the atlas' top-left corner
+// the texture coordinates are normalized with the same origin
+// the bearings go from the pen position on the baseline to the bitmap's top-left corner (Y up)
+// bearings and advance are in pixels
+struct AtlasGlyph
 {
+	u32 codePoint;
 	u16 x, y;
+	u16 width, height;
+	f32 u1, v1;
+	f32 u2, v2;
+	f32 bearingX, bearingY;
+	f32 advance;
 };
 
 #pragma pack(pop)
 
 
-std::vector<SluggishCodePoint> codePoints;
-std::vector<ushort2> bandsTexture;
-std::vector<float4> curvesTexture;
+Font font;
+Rasterizer rasterizer; // main thread only
+GlyphCache glyphCache;
+SharedGlyphCache sharedGlyphCache;
 
 
-#if defined(_DEBUG)
-static void CheckCurve(ushort2 b, float4 p12, float4 p3)
+// imageData must be w*h bytes
+static bool RenderCodePoint(u32 codePoint, u8* imageData, const char* outputPath, u32 w, u32 h, bool preverveAspect, u32 subpixelX, u32 subpixelY)
 {
-	if(b.x == BANDS_TAG_2 ||
-	   b.y == BANDS_TAG_2)
-	{
-		PrintWarning("Uninitialized band used.\n");
-	}
-	if(p12.x == CURVES_TAG_4 ||
-	   p12.y == CURVES_TAG_4 ||
-	   p12.z == CURVES_TAG_4 ||
-	   p12.w == CURVES_TAG_4 ||
-	   p3.x == CURVES_TAG_4 ||
-	   p3.y == CURVES_TAG_4)
-	{
-		PrintWarning("Uninitialized curve used.\n");
-	}
-}
-#define CHECK_CURVE(b, p12, p3) CheckCurve(b, p12, p3)
-#else
-#define CHECK_CURVE(b, p12, p3) ((void)0)
-#endif
+	TRACE_ZONE("RenderCodePoint");
 
-
-static bool LoadFont(const char* inputPath)
-{
-	File file;
-	if(!file.Open(inputPath, "rb"))
+	const SluggishCodePoint* const cpPtr = font.FindCodePoint(codePoint);
+	if(cpPtr == NULL)
 	{
-		PrintError("Failed to open font file: %s\n", inputPath);
+		PrintError("Failed to find code point U+%04X for file '%s'\n", (unsigned int)codePoint, outputPath);
 		return false;
 	}
 
-	char header[SLUGGISH_HEADER_LEN + 1];
-	file.Read(header, SLUGGISH_HEADER_LEN);
-	header[SLUGGISH_HEADER_LEN] = '\0';
-	if(strcmp(header, SLUGGISH_HEADER_DATA) != 0)
+	const SluggishCodePoint& cp = *cpPtr;
+	const u64 cacheKey = GlyphCache::MakeKey(codePoint, w, h, subpixelX, subpixelY, !preverveAspect, (u32)rasterizer.settings.aaMode);
+	const u64 sharedCacheFontHash = SharedGlyphCache::MakeFontHash(font.hash, rasterizer.settings, 0.0f, 0.0f, 0.0f); // the key has the sub-pixel offset
+	const u8* const cachedData = glyphCache.Find(cacheKey, w * h);
+	if(cachedData != NULL)
 	{
-		PrintError("Invalid header found (%s instead of %s): %s\n", header, SLUGGISH_HEADER_DATA, inputPath);
-		return false;
+		memcpy(imageData, cachedData, (size_t)(w * h));
+		printf("Duration: cached\n");
 	}
-
-	u16 codePointCount = 0;
-	file.Read(&codePointCount, sizeof(codePointCount));
-	if(codePointCount == 0)
+	else if(sharedGlyphCache.Find(sharedCacheFontHash, cacheKey, imageData, w * h, sharedGlyphCache.stats))
 	{
-		PrintError("No code points found: %s\n", inputPath);
-		return false;
+		glyphCache.Insert(cacheKey, imageData, w * h);
+		printf("Duration: cached (shared)\n");
 	}
+	else
+	{
+		LARGE_INTEGER start;
+		QueryPerformanceCounter(&start);
+
+		f32 scaleX, scaleY, offsetX, offsetY;
+		Rasterizer::ComputeGlyphTransform(cp, w, h, preverveAspect, (f32)subpixelX / (f32)GLYPH_CACHE_SUBPIXEL_STEPS, (f32)subpixelY / (f32)GLYPH_CACHE_SUBPIXEL_STEPS,
+										  &scaleX, &scaleY, &offsetX, &offsetY);
+		const u64 rayCount = rasterizer.Rasterize(font, cp, imageData, w, h, scaleX, scaleY, offsetX, offsetY);
+		glyphCache.Insert(cacheKey, imageData, w * h);
+		sharedGlyphCache.Insert(sharedCacheFontHash, cacheKey, imageData, w * h, sharedGlyphCache.stats);
+
+		LARGE_INTEGER end;
+		QueryPerformanceCounter(&end);
+
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency(&freq);
+		const u64 durationMS = (u64)(((LONGLONG)1000 * (end.QuadPart - start.QuadPart)) / freq.QuadPart);
+		printf("Duration: %u ms\n", (unsigned int)durationMS);
+		printf("Pixels: %u\n", (unsigned int)(w * h));
+		printf("Speed: %.1f ms per megapixel\n", (float)(1000000.0 * ((f64)durationMS / (f64)(w * h))));
+		printf("Rays: %.2f per pixel\n", (float)((f64)rayCount / (f64)(w * h)));
+	}
+
+	return true;
+}
 
-	codePoints.resize((size_t)codePointCount);
-	file.Read(&codePoints[0], codePoints.size() * sizeof(SluggishCodePoint));
+// renders the glyph strip by strip, each strip going straight to the output file
+// memory usage only depends on the strip's size, not on the image's
+static bool StreamCodePoint(u32 codePoint, const char* outputPath, ImageFormat format, u32 w, u32 h, bool preverveAspect, u32 subpixelX, u32 subpixelY,
+							u32 stripRows, u32 threadCount, std::vector<u8>& strip)
+{
+	TRACE_ZONE("StreamCodePoint");
 
-	u16 curveTextureWidth;
-	u16 curveTextureHeight;
-	u32 curveTextureBytes;
-	file.Read(&curveTextureWidth, sizeof(curveTextureWidth));
-	file.Read(&curveTextureHeight, sizeof(curveTextureHeight));
-	file.Read(&curveTextureBytes, sizeof(curveTextureBytes));
-	if(curveTextureWidth == 0 || curveTextureHeight == 0 || curveTextureBytes == 0 || curveTextureWidth != TEXTURE_WIDTH)
+	const SluggishCodePoint* const cpPtr = font.FindCodePoint(codePoint);
+	if(cpPtr == NULL)
 	{
-		PrintError("Invalid curves texture dimensions: %s\n", inputPath);
+		PrintError("Failed to find code point U+%04X for file '%s'\n", (unsigned int)codePoint, outputPath);
 		return false;
 	}
 
-	const size_t curveTexTexels = (size_t)curveTextureWidth * (size_t)curveTextureHeight;
-	curvesTexture.resize(curveTexTexels);
-	memset(&curvesTexture[0], CURVES_TAG_1, curveTexTexels * sizeof(curvesTexture[0]));
-	file.Read(&curvesTexture[0], (size_t)curveTextureBytes);
+	const SluggishCodePoint& cp = *cpPtr;
 
-	u16 bandsTextureWidth;
-	u16 bandsTextureHeight;
-	u32 bandsTextureBytes;
-	file.Read(&bandsTextureWidth, sizeof(bandsTextureWidth));
-	file.Read(&bandsTextureHeight, sizeof(bandsTextureHeight));
-	file.Read(&bandsTextureBytes, sizeof(bandsTextureBytes));
-	if(bandsTextureWidth == 0 || bandsTextureHeight == 0 || bandsTextureBytes == 0 || bandsTextureWidth != TEXTURE_WIDTH)
+	ImageStream stream;
+	if(!stream.Open(outputPath, format, w, h))
 	{
-		PrintError("Invalid bands texture dimensions: %s\n", inputPath);
+		PrintError("Failed to open output image file '%s'\n", outputPath);
 		return false;
 	}
 
-	const size_t bandsTexTexels = (size_t)bandsTextureWidth * (size_t)bandsTextureHeight;
-	bandsTexture.resize(bandsTexTexels);
-	memset(&bandsTexture[0], BANDS_TAG_1, bandsTexTexels * sizeof(bandsTexture[0]));
-	file.Read(&bandsTexture[0], (size_t)bandsTextureBytes);
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
 
-	return true;
-}
+	f32 scaleX, scaleY, offsetX, offsetY;
+	Rasterizer::ComputeGlyphTransform(cp, w, h, preverveAspect, (f32)subpixelX / (f32)GLYPH_CACHE_SUBPIXEL_STEPS, (f32)subpixelY / (f32)GLYPH_CACHE_SUBPIXEL_STEPS,
+									  &scaleX, &scaleY, &offsetX, &offsetY);
 
-static f32 TraceRayBand(bool vertical, u32 curveCount, u32 bandOffset, f32 fx0, f32 fy0, f32 pixelsPerEm)
-{
-	f32 coverage = 0.0f;
-
-	// run an intersection test against every curve in the selected band
-	for(u32 curveIdx = 0; curveIdx < curveCount; ++curveIdx)
-	{
-		// locate and load the curve data
-		const ushort2 curveCoords = bandsTexture[bandOffset + curveIdx];
-		const u32 curveX = curveCoords.x;
-		const u32 curveY = curveCoords.y;
-		const float4 cp12 = curvesTexture[curveY * TEXTURE_WIDTH + curveX + 0];
-		const float4 cp3 = curvesTexture[curveY * TEXTURE_WIDTH + curveX + 1];
-		CHECK_CURVE(curveCoords, cp12, cp3);
-
-		// compute the 3 curve points relative to the current pixel (fx0, fy0)
-		// when we want to trace vertically, we swizzle the coordinates
-		// we can then continue as if we were tracing a horizontal ray
-		float2 p1, p2, p3;
-		if(vertical)
-		{
-			p1 = { cp12.y - fy0, cp12.x - fx0 };
-			p2 = { cp12.w - fy0, cp12.z - fx0 };
-			p3 = { cp3.y - fy0, cp3.x - fx0 };
-		}
-		else
-		{
-			p1 = { cp12.x - fx0, cp12.y - fy0 };
-			p2 = { cp12.z - fx0, cp12.w - fy0 };
-			p3 = { cp3.x - fx0, cp3.y - fy0 };
-		}
+	stripRows = Min(stripRows, h);
+	strip.resize((size_t)w * (size_t)stripRows);
+	threadCount = Clamp(threadCount, 1u, stripRows);
+	std::atomic<u64> rayCount(0);
 
-		if(Max(p1.x, p2.x, p3.x) * pixelsPerEm < -0.5f)
+	for(u32 firstRow = 0; firstRow < h; firstRow += stripRows)
+	{
+		// each thread gets a contiguous group of rows
+		const u32 rowCount = Min(stripRows, h - firstRow);
+		const u32 rowsPerThread = (rowCount + threadCount - 1) / threadCount;
+		const auto renderRows = [&](u32 t)
 		{
-			// the rightmost coordinate of this curve is to the left of this pixel's
-			// this means means we have no more curves to intersect with
-			// since the curve data is sorted
-			break;
-		}
+			TRACE_ZONE("StreamCodePoint strip");
+			const u32 r0 = Min(t * rowsPerThread, rowCount);
+			const u32 r1 = Min(r0 + rowsPerThread, rowCount);
+			if(r1 > r0)
+			{
+				Rasterizer threadRasterizer;
+				threadRasterizer.settings = rasterizer.settings;
+				rayCount += threadRasterizer.RasterizeRows(font, cp, &strip[(size_t)r0 * (size_t)w], w, h, firstRow + r0, r1 - r0, scaleX, scaleY, offsetX, offsetY);
+			}
+		};
 
-		// solve the quadratic equation: a*t*t - 2*b*t + c = 0
-		const f32 a = p1.y - 2.0f * p2.y + p3.y;
-		const f32 b = p1.y - p2.y;
-		const f32 c = p1.y;
-		f32 t1, t2;
-		if(fabsf(a) < 0.0001f)
+		std::vector<std::thread> threads;
+		for(u32 t = 1; t < threadCount; ++t)
 		{
-			// a is too close to 0, so we solve this linear equation instead: c - 2*b*t = 0
-			t1 = t2 = c / (2.0f * b);
+			threads.push_back(std::thread([&renderRows, t]()
+			{
+				TRACE_THREAD_NAME("strip worker");
+				renderRows(t);
+			}));
 		}
-		else
+		renderRows(0);
+		for(auto& thread : threads)
 		{
-			// all is good, we find the 2 roots the usual way
-			const f32 rootArg = Max(b*b - a*c, 0.0f);
-			const f32 root = sqrtf(rootArg);
-			t1 = (b - root) / a;
-			t2 = (b + root) / a;
+			thread.join();
 		}
 
-		// generate the curve classification code and update the coverage accordingly
-		const uint input = ((p1.y > 0.0f) ? 2 : 0) + ((p2.y > 0.0f) ? 4 : 0) + ((p3.y > 0.0f) ? 8 : 0);
-		const uint output = 0x2E74 >> input;
-		if((output & 1) != 0)
+		if(!stream.WriteRows(&strip[0], rowCount))
 		{
-			const f32 r1 = EvaluateQuadraticBezierCurve(p1.x, p2.x, p3.x, t1);
-			coverage += Clamp(0.5f + r1 * pixelsPerEm, 0.0f, 1.0f);
-		}
-		if((output & 2) != 0)
-		{
-			const f32 r2 = EvaluateQuadraticBezierCurve(p1.x, p2.x, p3.x, t2);
-			coverage -= Clamp(0.5f + r2 * pixelsPerEm, 0.0f, 1.0f);
+			PrintError("Failed to write output image file '%s'\n", outputPath);
+			return false;
 		}
 	}
 
-	return coverage;
+	if(!stream.Close())
+	{
+		PrintError("Failed to write output image file '%s'\n", outputPath);
+		return false;
+	}
+
+	LARGE_INTEGER end;
+	QueryPerformanceCounter(&end);
+
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	const u64 pixelCount = (u64)w * (u64)h;
+	const u64 durationMS = (u64)(((LONGLONG)1000 * (end.QuadPart - start.QuadPart)) / freq.QuadPart);
+	printf("Duration: %u ms\n", (unsigned int)durationMS);
+	printf("Pixels: %llu in strips of %u rows\n", (unsigned long long)pixelCount, stripRows);
+	printf("Speed: %.1f ms per megapixel\n", (float)(1000000.0 * ((f64)durationMS / (f64)pixelCount)));
+	printf("Rays: %.2f per pixel\n", (float)((f64)rayCount / (f64)pixelCount));
+
+	return true;
 }
 
-static bool RenderCodePoint(u32 codePoint, const char* outputPath, u32 w, u32 h, bool preverveAspect)
+static bool WriteAtlasMetrics(const char* outputPath, u32 atlasWidth, u32 atlasHeight, const AtlasFontInfo& info, const std::vector<AtlasGlyph>& glyphs)
 {
-	SluggishCodePoint cp = { 0 };
-	bool found = false;
-	for(const auto& c : codePoints)
+	File file;
+	if(!file.Open(outputPath, "wb"))
 	{
-		if(c.codePoint == codePoint)
-		{
-			found = true;
-			cp = c;
-			break;
-		}
+		PrintError("Failed to open output file: %s\n", outputPath);
+		return false;
 	}
 
-	if(!found)
+	const u32 glyphCount = (u32)glyphs.size();
+	if(!file.Write(ATLAS_HEADER_DATA, ATLAS_HEADER_LEN) ||
+	   !file.Write(&atlasWidth, sizeof(atlasWidth)) ||
+	   !file.Write(&atlasHeight, sizeof(atlasHeight)) ||
+	   !file.Write(&info, sizeof(info)) ||
+	   !file.Write(&glyphCount, sizeof(glyphCount)) ||
+	   (glyphCount > 0 && !file.Write(&glyphs[0], glyphs.size() * sizeof(AtlasGlyph))))
 	{
-		PrintError("Failed to find code point U+%04X for file '%s'\n", (unsigned int)codePoint, outputPath);
+		PrintError("Failed to write output file: %s\n", outputPath);
 		return false;
 	}
 
-	Buffer image;
-	if(!AllocBuffer(image, w * h))
+	return true;
+}
+
+// renders all the code points of the range at the specified size into a single packed image
+static bool BakeAtlas(const char* outputPathBase, u32 start, u32 end, f32 pixelsPerEm, u32 padding, u32 threadCount)
+{
+	TRACE_ZONE("BakeAtlas");
+
+	struct AtlasItem
 	{
-		PrintError("Failed to allocate image buffer for file '%s'\n", outputPath);
-		return false;
-	}
+		const SluggishCodePoint* cp;
+		u32 w, h;
+		u32 x, y;
+	};
+
+	FontMetrics metrics;
+	font.GetMetrics(metrics, pixelsPerEm);
+	const f32 s = metrics.pixelsPerUnit;
+
+	std::vector<AtlasItem> items;
+	u32 missingCount = 0;
+	u64 totalArea = 0;
+	u32 maxWidth = 0;
+	for(u32 i = start; i <= end; ++i)
+	{
+		const SluggishCodePoint* const cp = font.FindCodePoint(i);
+		if(cp == NULL)
+		{
+			++missingCount;
+			continue;
+		}
 
-	LARGE_INTEGER start;
-	QueryPerformanceCounter(&start);
+		// the extra pixel makes sure we don't cut the right and top edges' anti-aliasing
+		AtlasItem item;
+		item.cp = cp;
+		item.w = (u32)ceilf((f32)cp->width * s) + 1;
+		item.h = (u32)ceilf((f32)cp->height * s) + 1;
+		item.x = 0;
+		item.y = 0;
+		items.push_back(item);
+		totalArea += (u64)(item.w + padding) * (u64)(item.h + padding);
+		maxWidth = Max(maxWidth, item.w + 2 * padding);
+	}
 
-	f32 scaleX = (f32)cp.width / (f32)w;
-	f32 scaleY = (f32)cp.height / (f32)h;
-	if(preverveAspect)
+	if(items.empty())
 	{
-		const f32 s = Max(scaleX, scaleY);
-		scaleX = s;
-		scaleY = s;
+		PrintError("No code point found in the range U+%04X -> U+%04X\n", start, end);
+		return false;
 	}
 
-	const f32 offsetX = 0.0f;
-	const f32 offsetY = 0.0f;
-	const f32 pixelsPerEmX = 1.0f / scaleX;
-	const f32 pixelsPerEmY = 1.0f / scaleY;
+	//
+	// pack the glyphs, tallest first
+	// ties are broken by code point to keep the result deterministic
+	//
+
+	std::sort(std::begin(items), std::end(items), [](const AtlasItem& a, const AtlasItem& b)
+	{
+		if(a.h != b.h) return a.h > b.h;
+		if(a.w != b.w) return a.w > b.w;
+		return a.cp->codePoint < b.cp->codePoint;
+	});
 
-	u8* imageData = (u8*)image.buffer;
-	memset(imageData, 0, (size_t)(w * h));
+	u32 atlasWidth = 64;
+	while(atlasWidth < ATLAS_MAX_SIZE && ((u64)atlasWidth * (u64)atlasWidth < totalArea || atlasWidth < maxWidth))
+	{
+		atlasWidth *= 2;
+	}
 
-	const u32 bandCount = cp.bandCount;
-	for(u32 y = 0, yi = h - 1; y < h; ++y, --yi)
+	SkylinePacker packer;
+	packer.Init(atlasWidth - padding, ATLAS_MAX_SIZE - padding);
+	for(auto& item : items)
 	{
-		// compute this pixel's Y coordinate in em-space
-		// compute horizontal band index
-		const f32 fy0 = offsetY + (f32)y * scaleY;
-		const u32 hBandIdx = (u32)(fy0 / (f32)cp.bandDimY);
-		if(hBandIdx >= cp.bandCount)
+		if(!packer.Pack(item.w + padding, item.h + padding, &item.x, &item.y))
 		{
-			// no band contains any curve we could intersect
-			continue;
+			PrintError("The glyphs don't fit in a %ux%u atlas, try a smaller size\n", ATLAS_MAX_SIZE, ATLAS_MAX_SIZE);
+			return false;
 		}
 
-		// locate and load the horizontal band's data
-		const ushort2 hBand = bandsTexture[cp.bandsTexCoordY * TEXTURE_WIDTH + cp.bandsTexCoordX + hBandIdx];
-		const u32 hBandCurveCount = hBand.x;
-		const u32 hBandBandOffset = hBand.y;
+		item.x += padding;
+		item.y += padding;
+	}
+
+	const u32 atlasHeight = (packer.GetUsedHeight() + padding + 3) & (~3u);
+	std::vector<u8> atlas((size_t)atlasWidth * (size_t)atlasHeight, 0);
+
+	//
+	// render the glyphs in parallel
+	// every glyph has its own rectangle, so the threads never write to the same pixels
+	//
 
-		for(u32 x = 0; x < w; ++x)
+	LARGE_INTEGER startTime;
+	QueryPerformanceCounter(&startTime);
+
+	std::atomic<u32> nextItem(0);
+	const auto renderItems = [&]()
+	{
+		Rasterizer threadRasterizer;
+		threadRasterizer.settings = rasterizer.settings;
+		std::vector<u8> scratch;
+		for(;;)
 		{
-			// compute this pixel's X coordinate in em-space
-			// compute vertical band index
-			const f32 fx0 = offsetX + (f32)x * scaleX;
-			const u32 vBandIdx = (u32)(fx0 / (f32)cp.bandDimX);
-			if(vBandIdx >= cp.bandCount)
+			const u32 i = nextItem++;
+			if(i >= (u32)items.size())
 			{
-				// no band contains any curve we could intersect
-				continue;
+				break;
 			}
 
-			// locate and load the vertical band's data
-			const ushort2 vBand = bandsTexture[cp.bandsTexCoordY * TEXTURE_WIDTH + cp.bandsTexCoordX + bandCount + vBandIdx];
-			const u32 vBandCurveCount = vBand.x;
-			const u32 vBandBandOffset = vBand.y;
-
-			// trace 2 rays for cheap (but imperfect) AA
-			// compute the final coverage
-			// write the pixel
-			f32 coverageX = TraceRayBand(false, hBandCurveCount, hBandBandOffset, fx0, fy0, pixelsPerEmX);
-			f32 coverageY = TraceRayBand(true,  vBandCurveCount, vBandBandOffset, fx0, fy0, pixelsPerEmY);
-			coverageX = Min(fabsf(coverageX), 1.0f);
-			coverageY = Min(fabsf(coverageY), 1.0f);
-			const f32 coverage = (coverageX + coverageY) * 0.5f;
-			imageData[yi*w + x] = (u8)(coverage * 255.0f);
+			const AtlasItem& item = items[i];
+			scratch.resize((size_t)(item.w * item.h));
+			threadRasterizer.Rasterize(font, *item.cp, &scratch[0], item.w, item.h, 1.0f / s, 1.0f / s, 0.0f, 0.0f);
+			for(u32 y = 0; y < item.h; ++y)
+			{
+				memcpy(&atlas[(size_t)(item.y + y) * atlasWidth + item.x], &scratch[(size_t)y * item.w], (size_t)item.w);
+			}
 		}
+	};
+
+	threadCount = Clamp(threadCount, 1u, (u32)items.size());
+	std::vector<std::thread> threads;
+	for(u32 t = 1; t < threadCount; ++t)
+	{
+		threads.push_back(std::thread([&renderItems]()
+		{
+			TRACE_THREAD_NAME("atlas worker");
+			renderItems();
+		}));
+	}
+	renderItems();
+	for(auto& thread : threads)
+	{
+		thread.join();
 	}
 
-	LARGE_INTEGER end;
-	QueryPerformanceCounter(&end);
+	LARGE_INTEGER endTime;
+	QueryPerformanceCounter(&endTime);
 
-	if(!stbi_write_tga(outputPath, w, h, 1, imageData))
+	//
+	// write the image and the metrics table
+	//
+
+	std::vector<AtlasGlyph> glyphs;
+	for(const auto& item : items)
 	{
-		PrintError("Failed to write output image file '%s'\n", outputPath);
+		const SluggishCodePoint& cp = *item.cp;
+		AtlasGlyph g;
+		g.codePoint = cp.codePoint;
+		g.x = (u16)item.x;
+		g.y = (u16)item.y;
+		g.width = (u16)item.w;
+		g.height = (u16)item.h;
+		g.u1 = (f32)item.x / (f32)atlasWidth;
+		g.v1 = (f32)item.y / (f32)atlasHeight;
+		g.u2 = (f32)(item.x + item.w) / (f32)atlasWidth;
+		g.v2 = (f32)(item.y + item.h) / (f32)atlasHeight;
+		g.bearingX = (f32)cp.bearingX * s;
+		g.bearingY = (f32)cp.bearingY * s + (f32)item.h;
+		g.advance = (f32)cp.advance * s;
+		glyphs.push_back(g);
+	}
+	std::sort(std::begin(glyphs), std::end(glyphs), [](const AtlasGlyph& a, const AtlasGlyph& b) { return a.codePoint < b.codePoint; });
+
+	AtlasFontInfo info;
+	info.pixelsPerEm = pixelsPerEm;
+	info.ascent = metrics.ascent;
+	info.descent = metrics.descent;
+	info.lineGap = metrics.lineGap;
+
+	char imagePath[512];
+	char metricsPath[512];
+	sprintf(imagePath, "%s_atlas_%g.tga", outputPathBase, pixelsPerEm);
+	sprintf(metricsPath, "%s_atlas_%g.atlas", outputPathBase, pixelsPerEm);
+	if(!WriteImage(imagePath, IMAGE_FORMAT_TGA, atlasWidth, atlasHeight, &atlas[0]))
+	{
+		PrintError("Failed to write output image file '%s'\n", imagePath);
 		return false;
 	}
 
+	if(!WriteAtlasMetrics(metricsPath, atlasWidth, atlasHeight, info, glyphs))
+	{
+		return false;
+	}
+
+	u64 glyphArea = 0;
+	for(const auto& item : items)
+	{
+		glyphArea += (u64)item.w * (u64)item.h;
+	}
+
 	LARGE_INTEGER freq;
 	QueryPerformanceFrequency(&freq);
-	const u64 durationMS = (u64)(((LONGLONG)1000 * (end.QuadPart - start.QuadPart)) / freq.QuadPart);
-	printf("Duration: %u ms\n", (unsigned int)durationMS);
-	printf("Pixels: %u\n", (unsigned int)(w * h));
-	printf("Speed: %.1f ms per megapixel\n", (float)(1000000.0 * ((f64)durationMS / (f64)(w * h))));
+	const u64 durationMS = (u64)(((LONGLONG)1000 * (endTime.QuadPart - startTime.QuadPart)) / freq.QuadPart);
+	PrintInfo("Atlas: %u glyphs (%u missing) in %ux%u pixels, %.1f%% used\n",
+			  (unsigned int)items.size(), missingCount, atlasWidth, atlasHeight, (f32)(100.0 * (f64)glyphArea / ((f64)atlasWidth * (f64)atlasHeight)));
+	PrintInfo("Duration: %u ms with %u thread(s)\n", (unsigned int)durationMS, threadCount);
+	PrintInfo("'%s' and '%s' DONE\n", imagePath, metricsPath);
 
 	return true;
 }
@@ -322,9 +446,14 @@ int main(int argc, char** argv)
 {
 	if(ShouldPrintHelp(argc, argv))
 	{
-		printf("Renders code points from a Sluggish font file into .tga images.\n");
+		printf("Renders code points from a Sluggish font file into images.\n");
 		printf("\n");
 		printf("%s <input%s> [-range=start,end] [-res=width,height] [-stretch]\n", GetExecutableFileName(argv[0]), SLUGGISH_EXTENSION_NAME);
+		printf("         [-offset=x,y] [-cache=megabytes] [-repeat=count]\n");
+		printf("         [-atlas=pixels_per_em] [-padding=pixels] [-threads=count]\n");
+		printf("         [-queue=count] [-format=tga|pgm|raw] [-stream] [-strip=rows]\n");
+		printf("         [-aa=1|2|adaptive] [-aathreshold=x] [-serve]\n");
+		printf("         [-sharedcache=path[,megabytes]] [-trace=file.json]\n");
 		printf("\n");
 		printf("range    The start and end numbers are Unicode code points.\n");
 		printf("         e.g. '90' for the letter 'Z'\n");
@@ -333,19 +462,82 @@ int main(int argc, char** argv)
 		printf("         By default, the resolution is 1024x1024.\n");
 		printf("stretch  Use all the available space to render the glyph.\n");
 		printf("         By default, the original aspect ratio is preserved.\n");
+		printf("offset   Sub-pixel offset of the glyph in pixels, in the range [0,1).\n");
+		printf("         It gets snapped to 1/%d of a pixel.\n", GLYPH_CACHE_SUBPIXEL_STEPS);
+		printf("cache    Memory budget of the rendered glyphs cache.\n");
+		printf("         By default, the cache is disabled. Allowed range: [0,4095].\n");
+		printf("sharedcache  A file mapped in memory that caches the rendered glyphs\n");
+		printf("         of every fontrender process using it. The first process\n");
+		printf("         creates it (64 MB by default, 4095 max.) with slots that fit its 'res'.\n");
+		printf("         Used by the default mode and 'serve', not by 'stream' and 'atlas'.\n");
+		printf("         By default, the shared cache is disabled.\n");
+		printf("repeat   The number of times the whole range gets rendered.\n");
+		printf("         By default, it's rendered once.\n");
+		printf("atlas    Renders the whole range at the specified size into a single\n");
+		printf("         packed image and writes the glyph metrics to an %s file.\n", ".atlas");
+		printf("padding  The number of empty pixels around each glyph of the atlas.\n");
+		printf("         By default, the padding is 1.\n");
+		printf("threads  The number of threads used to render the atlas.\n");
+		printf("         By default, all the available hardware threads are used.\n");
+		printf("queue    The maximum number of images waiting to be written to disk\n");
+		printf("         while the next ones get rendered.\n");
+		printf("         By default, the queue holds 8 images.\n");
+		printf("format   The output image file format.\n");
+		printf("         'raw' is 8-bit rows with no header, top row first.\n");
+		printf("         By default, the format is 'tga'.\n");
+		printf("stream   Renders horizontal strips and writes them to disk as they're done.\n");
+		printf("         Memory usage no longer depends on the resolution.\n");
+		printf("         Images are written uncompressed.\n");
+		printf("strip    The number of rows per strip in stream mode.\n");
+		printf("         By default, a strip holds about %u MB of pixels.\n", STREAM_STRIP_BYTES >> 20);
+		printf("         With -aa=adaptive, every strip and thread traces 2 extra rows\n");
+		printf("         (not counted in 'Rays'), so small strips are slower.\n");
+		printf("aa       The anti-aliasing policy.\n");
+		printf("         1: a single horizontal ray per pixel (fastest).\n");
+		printf("         2: a horizontal and a vertical ray per pixel.\n");
+		printf("         adaptive: 1 ray in flat areas, 2 near edges and 6 where\n");
+		printf("         the first 2 rays disagree (best quality).\n");
+		printf("         By default, 2 rays are traced per pixel.\n");
+		printf("aathreshold  Adaptive mode: the maximum coverage difference in [0,1]\n");
+		printf("         between the first 2 rays before we super-sample.\n");
+		printf("         Lower is slower and smoother. By default, it's 0.25.\n");
+		printf("serve    Keeps running and renders the requests read from stdin,\n");
+		printf("         one per line, on 'threads' worker threads. The images are\n");
+		printf("         sent to stdout in request order and 'queue' limits the\n");
+		printf("         number of glyphs in flight. The other options are the\n");
+		printf("         defaults of the requests. A request looks like this:\n");
+		printf("         <id> [-font=path] [-range=start,end] [-res=width,height]\n");
+		printf("         [-ppem=pixels_per_em] [-stretch] [-offset=x,y] [-format=f]\n");
+		printf("         [-aa=mode] [-aathreshold=x] [-text=rest of the line]\n");
+		printf("         Responses: 'glyph <id> <code point> <w> <h> <bytes>' + image,\n");
+		printf("         'missing <id> <code point>', then 'done <id> <glyphs>\n");
+		printf("         <missing> <microseconds>' or 'error <id> <message>'.\n");
+		printf("trace    Writes the timings of the loading, rendering and writing steps\n");
+		printf("         of every thread to a Chrome trace file (chrome://tracing or\n");
+		printf("         ui.perfetto.dev). Only in the debug builds or when premake\n");
+		printf("         got the --trace option.\n");
 		return 1337;
 	}
 
-	if(!LoadFont(argv[1]))
-	{
-		return 1;
-	}
-
 	u32 start = 'A';
 	u32 end = 'A';
 	u32 width = 1024;
 	u32 height = 1024;
 	bool preserveAspect = true;
+	u32 subpixelX = 0;
+	u32 subpixelY = 0;
+	u32 repeatCount = 1;
+	f32 atlasPixelsPerEm = 0.0f;
+	u32 atlasPadding = 1;
+	u32 threadCount = Max(std::thread::hardware_concurrency(), 1u);
+	u32 queueDepth = 8;
+	ImageFormat format = IMAGE_FORMAT_TGA;
+	bool stream = false;
+	u32 stripRows = 0;
+	bool serve = false;
+	char sharedCachePath[512] = { 0 };
+	u32 sharedCacheMB = 64;
+	char tracePath[512] = { 0 };
 	for(int i = 2; i < argc; ++i)
 	{
 		const char* const arg = argv[i];
@@ -371,6 +563,142 @@ int main(int argc, char** argv)
 		{
 			preserveAspect = false;
 		}
+		else if(strstr(arg, "-offset=") == arg)
+		{
+			f32 x, y;
+			if(sscanf(arg, "-offset=%f,%f", &x, &y) == 2 && x >= 0.0f && x < 1.0f && y >= 0.0f && y < 1.0f)
+			{
+				// rounding up to the next pixel would undo the offset, so the last bucket takes the rest
+				subpixelX = Min((u32)(x * (f32)GLYPH_CACHE_SUBPIXEL_STEPS + 0.5f), (u32)GLYPH_CACHE_SUBPIXEL_STEPS - 1);
+				subpixelY = Min((u32)(y * (f32)GLYPH_CACHE_SUBPIXEL_STEPS + 0.5f), (u32)GLYPH_CACHE_SUBPIXEL_STEPS - 1);
+			}
+		}
+		else if(strstr(arg, "-cache=") == arg)
+		{
+			u32 mb;
+			if(sscanf(arg, "-cache=%u", &mb) == 1 && mb < 4096)
+			{
+				glyphCache.SetBudget((uptr)mb << 20);
+			}
+		}
+		else if(strstr(arg, "-sharedcache=") == arg)
+		{
+			char path[512];
+			u32 mb = sharedCacheMB;
+			if(sscanf(arg, "-sharedcache=%511[^,],%u", path, &mb) >= 1 && mb >= 1 && mb < 4096)
+			{
+				strcpy(sharedCachePath, path);
+				sharedCacheMB = mb;
+			}
+		}
+		else if(strstr(arg, "-repeat=") == arg)
+		{
+			u32 r;
+			if(sscanf(arg, "-repeat=%u", &r) == 1 && r >= 1)
+			{
+				repeatCount = r;
+			}
+		}
+		else if(strstr(arg, "-atlas=") == arg)
+		{
+			f32 ppem;
+			if(sscanf(arg, "-atlas=%f", &ppem) == 1 && ppem >= 1.0f && ppem <= 4096.0f)
+			{
+				atlasPixelsPerEm = ppem;
+			}
+		}
+		else if(strstr(arg, "-padding=") == arg)
+		{
+			u32 p;
+			if(sscanf(arg, "-padding=%u", &p) == 1 && p <= 64)
+			{
+				atlasPadding = p;
+			}
+		}
+		else if(strstr(arg, "-threads=") == arg)
+		{
+			u32 t;
+			if(sscanf(arg, "-threads=%u", &t) == 1 && t >= 1)
+			{
+				threadCount = t;
+			}
+		}
+		else if(strstr(arg, "-queue=") == arg)
+		{
+			u32 q;
+			if(sscanf(arg, "-queue=%u", &q) == 1 && q >= 1 && q <= 256)
+			{
+				queueDepth = q;
+			}
+		}
+		else if(strstr(arg, "-format=") == arg)
+		{
+			if(!ParseImageFormat(arg + 8, &format))
+			{
+				PrintWarning("Unknown image format '%s', using '%s'\n", arg + 8, GetImageFormatExtension(format));
+			}
+		}
+		else if(strstr(arg, "-aa=") == arg)
+		{
+			if(strcmp(arg + 4, "1") == 0)
+			{
+				rasterizer.settings.aaMode = AA_MODE_1RAY;
+			}
+			else if(strcmp(arg + 4, "2") == 0)
+			{
+				rasterizer.settings.aaMode = AA_MODE_2RAYS;
+			}
+			else if(strcmp(arg + 4, "adaptive") == 0)
+			{
+				rasterizer.settings.aaMode = AA_MODE_ADAPTIVE;
+			}
+		}
+		else if(strstr(arg, "-aathreshold=") == arg)
+		{
+			f32 t;
+			if(sscanf(arg, "-aathreshold=%f", &t) == 1 && t >= 0.0f && t <= 1.0f)
+			{
+				rasterizer.settings.aaThreshold = t;
+			}
+		}
+		else if(strcmp(arg, "-stream") == 0)
+		{
+			stream = true;
+		}
+		else if(strcmp(arg, "-serve") == 0)
+		{
+			serve = true;
+		}
+		else if(strstr(arg, "-strip=") == arg)
+		{
+			u32 rows;
+			if(sscanf(arg, "-strip=%u", &rows) == 1 && rows >= 1)
+			{
+				stripRows = rows;
+			}
+		}
+		else if(strstr(arg, "-trace=") == arg)
+		{
+			sscanf(arg, "-trace=%511s", tracePath);
+		}
+	}
+
+	// the trace gets written when we exit
+	if(tracePath[0] != '\0')
+	{
+		Trace_Open(tracePath);
+	}
+
+	if(sharedCachePath[0] != '\0' && !serve && (stream || atlasPixelsPerEm > 0.0f))
+	{
+		PrintError("The shared glyph cache can't be used with -stream or -atlas\n");
+		return 1;
+	}
+
+	// only the shared cache needs to identify the font
+	if(!font.Load(argv[1], FONT_LOAD_BAND_CURVES | (sharedCachePath[0] != '\0' ? FONT_LOAD_HASH : 0)))
+	{
+		return 1;
 	}
 
 	const char* inputPath = argv[1];
@@ -382,15 +710,109 @@ int main(int argc, char** argv)
 		outputPathBase[l - SLUGGISH_EXTENSION_LEN] = '\0';
 	}
 
+	if(serve)
+	{
+		// stdout carries the images, so nothing else may be printed there
+		_setmode(_fileno(stdout), _O_BINARY);
+
+		RenderOptions defaults;
+		defaults.font = &font;
+		defaults.width = width;
+		defaults.height = height;
+		defaults.pixelsPerEm = 0.0f;
+		defaults.preserveAspect = preserveAspect;
+		defaults.subpixelX = (f32)subpixelX / (f32)GLYPH_CACHE_SUBPIXEL_STEPS;
+		defaults.subpixelY = (f32)subpixelY / (f32)GLYPH_CACHE_SUBPIXEL_STEPS;
+		defaults.format = format;
+		defaults.raster = rasterizer.settings;
+
+		if(sharedCachePath[0] != '\0' && !sharedGlyphCache.Open(sharedCachePath, (uptr)sharedCacheMB << 20, width * height))
+		{
+			return 1;
+		}
+
+		RenderServer server;
+		server.Init(threadCount, queueDepth, stdout, sharedGlyphCache.IsEnabled() ? &sharedGlyphCache : NULL);
+		const u32 failureCount = server.Run(stdin, defaults);
+
+		return failureCount == 0 ? 0 : 1;
+	}
+
 	PrintInfo("Range: U+%04X -> U+%04X\n", start, end);
+
+	if(atlasPixelsPerEm > 0.0f)
+	{
+		PrintInfo("Atlas size: %g pixels per em\n", atlasPixelsPerEm);
+		return BakeAtlas(outputPathBase, start, end, atlasPixelsPerEm, atlasPadding, threadCount) ? 0 : 1;
+	}
+
 	PrintInfo("Resolution: %ux%u\n", width, height);
 
 	char fileName[512];
-	for(u32 i = start; i <= end; ++i)
+	if(stream)
+	{
+		if(stripRows == 0)
+		{
+			stripRows = Max(STREAM_STRIP_BYTES / width, 1u);
+		}
+
+		u32 failureCount = 0;
+		std::vector<u8> strip;
+		for(u32 r = 0; r < repeatCount; ++r)
+		{
+			for(u32 i = start; i <= end; ++i)
+			{
+				sprintf(fileName, "%s_U+%04X_%ux%u%s.%s", outputPathBase, i, width, height, preserveAspect ? "" : "_stretched", GetImageFormatExtension(format));
+				if(!StreamCodePoint(i, fileName, format, width, height, preserveAspect, subpixelX, subpixelY, stripRows, threadCount, strip))
+				{
+					++failureCount;
+				}
+			}
+		}
+
+		return failureCount == 0 ? 0 : 1;
+	}
+
+	if(sharedCachePath[0] != '\0' && !sharedGlyphCache.Open(sharedCachePath, (uptr)sharedCacheMB << 20, width * height))
+	{
+		return 1;
+	}
+
+	// rendering and writing to disk overlap
+	ImageWriter writer;
+	if(!writer.Init(queueDepth, (uptr)width * (uptr)height))
+	{
+		return 1;
+	}
+
+	for(u32 r = 0; r < repeatCount; ++r)
+	{
+		for(u32 i = start; i <= end; ++i)
+		{
+			sprintf(fileName, "%s_U+%04X_%ux%u%s.%s", outputPathBase, i, width, height, preserveAspect ? "" : "_stretched", GetImageFormatExtension(format));
+			u8* const imageData = writer.AcquireBuffer();
+			if(RenderCodePoint(i, imageData, fileName, width, height, preserveAspect, subpixelX, subpixelY))
+			{
+				writer.Submit(imageData, fileName, format, width, height);
+			}
+			else
+			{
+				writer.ReleaseBuffer(imageData);
+			}
+		}
+	}
+
+	const u32 failureCount = writer.Finish();
+
+	if(glyphCache.IsEnabled())
+	{
+		glyphCache.PrintStats();
+	}
+
+	if(sharedGlyphCache.IsEnabled())
 	{
-		sprintf(fileName, "%s_U+%04X_%ux%u%s.tga", outputPathBase, i, width, height, preserveAspect ? "" : "_stretched");
-		RenderCodePoint(i, fileName, width, height, preserveAspect);
+		sharedGlyphCache.PrintStats();
 	}
 
-	return 0;
+	return failureCount == 0 ? 0 : 1;
 }
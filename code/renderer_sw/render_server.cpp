@@ -0,0 +1,607 @@
+#include "render_server.hpp"
+#include "glyph_cache.hpp"
+#include "../sluggish/trace.hpp"
+
+#include <Windows.h>
+#include <string.h>
+#include <math.h>
+#include <unordered_set>
+
+
+// returns the position of the next character
+// invalid sequences decode to U+FFFD one byte at a time
+static const char* DecodeUTF8(const char* s, u32* codePoint)
+{
+	const u8 c = (u8)s[0];
+	u32 length = 0;
+	u32 cp = 0;
+	if(c < 0x80)
+	{
+		*codePoint = c;
+		return s + 1;
+	}
+	else if((c & 0xE0) == 0xC0)
+	{
+		length = 2;
+		cp = c & 0x1F;
+	}
+	else if((c & 0xF0) == 0xE0)
+	{
+		length = 3;
+		cp = c & 0x0F;
+	}
+	else if((c & 0xF8) == 0xF0)
+	{
+		length = 4;
+		cp = c & 0x07;
+	}
+	else
+	{
+		*codePoint = 0xFFFD;
+		return s + 1;
+	}
+
+	for(u32 i = 1; i < length; ++i)
+	{
+		if(((u8)s[i] & 0xC0) != 0x80)
+		{
+			*codePoint = 0xFFFD;
+			return s + 1;
+		}
+
+		cp = (cp << 6) | ((u8)s[i] & 0x3F);
+	}
+
+	*codePoint = cp;
+
+	return s + length;
+}
+
+// null-terminates the token and moves the cursor past it
+// returns NULL when there's nothing left
+static char* NextToken(char** cursor)
+{
+	char* c = *cursor;
+	while(*c == ' ' || *c == '\t')
+	{
+		++c;
+	}
+
+	if(*c == '\0')
+	{
+		*cursor = c;
+		return NULL;
+	}
+
+	char* const token = c;
+	while(*c != '\0' && *c != ' ' && *c != '\t')
+	{
+		++c;
+	}
+
+	if(*c != '\0')
+	{
+		*c++ = '\0';
+	}
+	*cursor = c;
+
+	return token;
+}
+
+
+RenderServer::RenderServer() : output(NULL), sharedCache(NULL), queueDepth(0), quit(false)
+{
+}
+
+RenderServer::~RenderServer()
+{
+	Finish();
+}
+
+void RenderServer::Init(u32 threadCount, u32 maxJobsInFlight, FILE* outputFile, SharedGlyphCache* sharedGlyphCache)
+{
+	// the workers should never wait for the writer to free a slot
+	threadCount = Max(threadCount, 1u);
+	output = outputFile;
+	sharedCache = sharedGlyphCache;
+	queueDepth = Max(maxJobsInFlight, 2 * threadCount);
+	quit = false;
+
+	for(u32 t = 0; t < threadCount; ++t)
+	{
+		workers.push_back(std::thread(&RenderServer::WorkerThread, this));
+	}
+	writer = std::thread(&RenderServer::WriterThread, this);
+}
+
+u32 RenderServer::Run(FILE* input, const RenderOptions& defaults)
+{
+	u32 failureCount = 0;
+	char line[RENDER_SERVER_MAX_LINE + 2];
+	std::vector<u32> codePoints;
+	while(fgets(line, sizeof(line), input) != NULL)
+	{
+		size_t l = strlen(line);
+		const bool truncated = l > 0 && line[l - 1] != '\n' && !feof(input);
+		if(truncated)
+		{
+			int c;
+			while((c = fgetc(input)) != EOF && c != '\n')
+			{
+			}
+		}
+
+		while(l > 0 && (line[l - 1] == '\n' || line[l - 1] == '\r'))
+		{
+			line[--l] = '\0';
+		}
+
+		char* cursor = line;
+		const char* const id = NextToken(&cursor);
+		if(id == NULL || id[0] == '#')
+		{
+			continue;
+		}
+
+		if(strcmp(id, "quit") == 0)
+		{
+			break;
+		}
+
+		LARGE_INTEGER startTime;
+		QueryPerformanceCounter(&startTime);
+
+		Request* const request = new Request();
+		request->id = id;
+		request->options = defaults;
+		request->glyphCount = 0;
+		request->missingCount = 0;
+		request->startTime = (s64)startTime.QuadPart;
+
+		std::string error;
+		if(truncated)
+		{
+			error = "the request is longer than " + std::to_string(RENDER_SERVER_MAX_LINE) + " bytes";
+		}
+
+		if(!error.empty() || !ParseRequest(*request, codePoints, cursor, error))
+		{
+			Job* const job = new Job();
+			job->type = JOB_ERROR;
+			job->request = request;
+			job->message = error;
+			job->ready = true;
+			PushJob(job);
+			++failureCount;
+			continue;
+		}
+
+		const RenderOptions& options = request->options;
+		FontMetrics metrics;
+		options.font->GetMetrics(metrics, options.pixelsPerEm);
+		for(u32 codePoint : codePoints)
+		{
+			Job* const job = new Job();
+			job->request = request;
+			job->codePoint = codePoint;
+			job->cp = options.font->FindCodePoint(codePoint);
+			job->width = options.width;
+			job->height = options.height;
+			job->ready = false;
+			if(job->cp == NULL)
+			{
+				job->type = JOB_MISSING;
+				job->ready = true;
+				++request->missingCount;
+			}
+			else
+			{
+				// the extra pixel makes sure we don't cut the right and top edges' anti-aliasing
+				job->type = JOB_GLYPH;
+				if(options.pixelsPerEm > 0.0f)
+				{
+					job->width = (u32)ceilf((f32)job->cp->width * metrics.pixelsPerUnit) + 1;
+					job->height = (u32)ceilf((f32)job->cp->height * metrics.pixelsPerUnit) + 1;
+				}
+				++request->glyphCount;
+			}
+			PushJob(job);
+		}
+
+		Job* const job = new Job();
+		job->type = JOB_DONE;
+		job->request = request;
+		job->ready = true;
+		PushJob(job);
+	}
+
+	Finish();
+
+	return failureCount;
+}
+
+void RenderServer::Finish()
+{
+	if(writer.joinable())
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			slotAvailable.wait(lock, [this] { return jobs.empty(); });
+			quit = true;
+		}
+		jobAvailable.notify_all();
+		jobReady.notify_all();
+
+		for(auto& worker : workers)
+		{
+			worker.join();
+		}
+		workers.clear();
+		writer.join();
+	}
+
+	for(auto& it : fonts)
+	{
+		delete it.second;
+	}
+	fonts.clear();
+}
+
+bool RenderServer::ParseRequest(Request& request, std::vector<u32>& codePoints, char* line, std::string& error)
+{
+	TRACE_ZONE("RenderServer::ParseRequest");
+
+	RenderOptions& options = request.options;
+	u32 start = 'A';
+	u32 end = 'A';
+	const char* text = NULL;
+	char* cursor = line;
+	for(;;)
+	{
+		// the text is the rest of the line, white space included
+		while(*cursor == ' ' || *cursor == '\t')
+		{
+			++cursor;
+		}
+
+		if(strstr(cursor, "-text=") == cursor)
+		{
+			text = cursor + 6;
+			break;
+		}
+
+		const char* const arg = NextToken(&cursor);
+		if(arg == NULL)
+		{
+			break;
+		}
+
+		if(strstr(arg, "-font=") == arg)
+		{
+			options.font = GetFont(arg + 6);
+			if(options.font == NULL)
+			{
+				error = std::string("failed to load font ") + (arg + 6);
+				return false;
+			}
+		}
+		else if(strstr(arg, "-range=") == arg)
+		{
+			u32 s, e;
+			if(sscanf(arg, "-range=%u,%u", &s, &e) != 2 || e < s || e > 0x10FFFF)
+			{
+				error = std::string("invalid option ") + arg;
+				return false;
+			}
+
+			start = s;
+			end = e;
+		}
+		else if(strstr(arg, "-res=") == arg)
+		{
+			u32 w, h;
+			if(sscanf(arg, "-res=%u,%u", &w, &h) != 2 || w < 1 || h < 1 || w > 8192 || h > 8192)
+			{
+				error = std::string("invalid option ") + arg;
+				return false;
+			}
+
+			options.width = w;
+			options.height = h;
+			options.pixelsPerEm = 0.0f;
+		}
+		else if(strstr(arg, "-ppem=") == arg)
+		{
+			f32 ppem;
+			if(sscanf(arg, "-ppem=%f", &ppem) != 1 || ppem < 1.0f || ppem > 2048.0f)
+			{
+				error = std::string("invalid option ") + arg;
+				return false;
+			}
+
+			options.pixelsPerEm = ppem;
+		}
+		else if(strcmp(arg, "-stretch") == 0)
+		{
+			options.preserveAspect = false;
+		}
+		else if(strstr(arg, "-offset=") == arg)
+		{
+			f32 x, y;
+			if(sscanf(arg, "-offset=%f,%f", &x, &y) != 2 || x < 0.0f || x >= 1.0f || y < 0.0f || y >= 1.0f)
+			{
+				error = std::string("invalid option ") + arg;
+				return false;
+			}
+
+			options.subpixelX = x;
+			options.subpixelY = y;
+		}
+		else if(strstr(arg, "-format=") == arg)
+		{
+			if(!ParseImageFormat(arg + 8, &options.format))
+			{
+				error = std::string("invalid option ") + arg;
+				return false;
+			}
+		}
+		else if(strstr(arg, "-aa=") == arg)
+		{
+			if(strcmp(arg + 4, "1") == 0)
+			{
+				options.raster.aaMode = AA_MODE_1RAY;
+			}
+			else if(strcmp(arg + 4, "2") == 0)
+			{
+				options.raster.aaMode = AA_MODE_2RAYS;
+			}
+			else if(strcmp(arg + 4, "adaptive") == 0)
+			{
+				options.raster.aaMode = AA_MODE_ADAPTIVE;
+			}
+			else
+			{
+				error = std::string("invalid option ") + arg;
+				return false;
+			}
+		}
+		else if(strstr(arg, "-aathreshold=") == arg)
+		{
+			f32 t;
+			if(sscanf(arg, "-aathreshold=%f", &t) != 1 || t < 0.0f || t > 1.0f)
+			{
+				error = std::string("invalid option ") + arg;
+				return false;
+			}
+
+			options.raster.aaThreshold = t;
+		}
+		else
+		{
+			error = std::string("unknown option ") + arg;
+			return false;
+		}
+	}
+
+	if(options.font == NULL)
+	{
+		error = "no font specified";
+		return false;
+	}
+
+	codePoints.clear();
+	if(text != NULL)
+	{
+		std::unordered_set<u32> seen;
+		while(*text != '\0')
+		{
+			u32 codePoint;
+			text = DecodeUTF8(text, &codePoint);
+			if(seen.insert(codePoint).second)
+			{
+				codePoints.push_back(codePoint);
+			}
+		}
+	}
+	else
+	{
+		for(u32 i = start; i <= end; ++i)
+		{
+			codePoints.push_back(i);
+		}
+	}
+
+	return true;
+}
+
+const Font* RenderServer::GetFont(const char* filePath)
+{
+	const auto it = fonts.find(filePath);
+	if(it != fonts.end())
+	{
+		return it->second;
+	}
+
+	// only the shared cache needs to identify the font
+	Font* const font = new Font();
+	if(!font->Load(filePath, FONT_LOAD_BAND_CURVES | (sharedCache != NULL ? FONT_LOAD_HASH : 0)))
+	{
+		// we'll try again next time
+		delete font;
+		return NULL;
+	}
+
+	fonts[filePath] = font;
+
+	return font;
+}
+
+void RenderServer::PushJob(Job* job)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		slotAvailable.wait(lock, [this] { return (u32)jobs.size() < queueDepth; });
+		jobs.push_back(job);
+		if(job->type == JOB_GLYPH)
+		{
+			pendingJobs.push_back(job);
+		}
+	}
+
+	if(job->type == JOB_GLYPH)
+	{
+		jobAvailable.notify_one();
+	}
+	else
+	{
+		jobReady.notify_one();
+	}
+}
+
+void RenderServer::WorkerThread()
+{
+	TRACE_THREAD_NAME("server worker");
+
+	Rasterizer rasterizer;
+	SharedGlyphCacheStats sharedCacheStats;
+	memset(&sharedCacheStats, 0, sizeof(sharedCacheStats));
+	for(;;)
+	{
+		Job* job = NULL;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAvailable.wait(lock, [this] { return quit || !pendingJobs.empty(); });
+			if(pendingJobs.empty())
+			{
+				break;
+			}
+
+			job = pendingJobs.front();
+			pendingJobs.pop_front();
+		}
+
+		TRACE_ZONE("RenderServer::RenderJob");
+		const RenderOptions& options = job->request->options;
+		const SluggishCodePoint& cp = *job->cp;
+		const u32 w = job->width;
+		const u32 h = job->height;
+		f32 scaleX, scaleY, offsetX, offsetY;
+		if(options.pixelsPerEm > 0.0f)
+		{
+			FontMetrics metrics;
+			options.font->GetMetrics(metrics, options.pixelsPerEm);
+			scaleX = 1.0f / metrics.pixelsPerUnit;
+			scaleY = scaleX;
+			offsetX = -scaleX * options.subpixelX;
+			offsetY = -scaleY * options.subpixelY;
+		}
+		else
+		{
+			Rasterizer::ComputeGlyphTransform(cp, w, h, options.preserveAspect, options.subpixelX, options.subpixelY, &scaleX, &scaleY, &offsetX, &offsetY);
+		}
+
+		u8 header[IMAGE_HEADER_MAX_BYTES];
+		const u32 headerBytes = GetImageHeader(header, options.format, w, h);
+		job->image.resize((size_t)headerBytes + (size_t)w * (size_t)h);
+		memcpy(&job->image[0], header, (size_t)headerBytes);
+		rasterizer.settings = options.raster;
+
+		// the requests' offsets aren't snapped, so they go into the font's identity instead of the key
+		u8* const imageData = &job->image[headerBytes];
+		const u64 cacheKey = GlyphCache::MakeKey(job->codePoint, w, h, 0, 0, !options.preserveAspect, (u32)options.raster.aaMode);
+		const u64 fontHash = SharedGlyphCache::MakeFontHash(options.font->hash, options.raster, options.pixelsPerEm, options.subpixelX, options.subpixelY);
+		if(sharedCache == NULL || !sharedCache->Find(fontHash, cacheKey, imageData, w * h, sharedCacheStats))
+		{
+			rasterizer.Rasterize(*options.font, cp, imageData, w, h, scaleX, scaleY, offsetX, offsetY);
+			if(sharedCache != NULL)
+			{
+				sharedCache->Insert(fontHash, cacheKey, imageData, w * h, sharedCacheStats);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job->ready = true;
+		}
+		jobReady.notify_one();
+	}
+
+	if(sharedCache != NULL)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sharedCache->AddStats(sharedCacheStats);
+	}
+}
+
+void RenderServer::WriterThread()
+{
+	TRACE_THREAD_NAME("server writer");
+
+	for(;;)
+	{
+		Job* job = NULL;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobReady.wait(lock, [this] { return quit || (!jobs.empty() && jobs.front()->ready); });
+			if(jobs.empty())
+			{
+				// we only leave once everything submitted has been written
+				break;
+			}
+
+			job = jobs.front();
+		}
+
+		// the job stays in the queue while we write it so that it counts against the budget
+		WriteJob(*job);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.pop_front();
+		}
+		slotAvailable.notify_one();
+
+		if(job->type == JOB_DONE || job->type == JOB_ERROR)
+		{
+			delete job->request;
+		}
+		delete job;
+	}
+
+	fflush(output);
+}
+
+void RenderServer::WriteJob(const Job& job)
+{
+	TRACE_ZONE("RenderServer::WriteJob");
+
+	const char* const id = job.request->id.c_str();
+	switch(job.type)
+	{
+		case JOB_GLYPH:
+			fprintf(output, "glyph %s %u %u %u %u\n", id, (unsigned int)job.codePoint, (unsigned int)job.width, (unsigned int)job.height, (unsigned int)job.image.size());
+			fwrite(&job.image[0], job.image.size(), 1, output);
+			break;
+
+		case JOB_MISSING:
+			fprintf(output, "missing %s %u\n", id, (unsigned int)job.codePoint);
+			break;
+
+		case JOB_DONE:
+		{
+			LARGE_INTEGER endTime;
+			QueryPerformanceCounter(&endTime);
+			LARGE_INTEGER freq;
+			QueryPerformanceFrequency(&freq);
+			const u64 durationUS = (u64)(((LONGLONG)1000000 * (endTime.QuadPart - (LONGLONG)job.request->startTime)) / freq.QuadPart);
+			fprintf(output, "done %s %u %u %llu\n", id, (unsigned int)job.request->glyphCount, (unsigned int)job.request->missingCount, (unsigned long long)durationUS);
+			fflush(output);
+			break;
+		}
+
+		case JOB_ERROR:
+			fprintf(output, "error %s %s\n", id, job.message.c_str());
+			fflush(output);
+			break;
+	}
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+
+#include "image_stream.hpp"
+#include "shared_glyph_cache.hpp"
+#include "../sluggish/rasterizer.hpp"
+#include "../shared.hpp"
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+/*
+Render server protocol
+
+Requests are read one per line:
+<id> [-font=path] [-range=start,end] [-res=width,height] [-ppem=pixels_per_em]
+     [-stretch] [-offset=x,y] [-format=tga|pgm|raw] [-aa=1|2|adaptive]
+     [-aathreshold=x] [-text=string]
+quit
+
+- the id can be anything without white space, it's echoed back by every response line
+- -text must come last: the rest of the line is UTF-8 text and each distinct code point gets rendered
+- -ppem renders every glyph in its own tight box (like the atlas) instead of fitting it to -res
+- the options that aren't specified use the values from the command line
+- fonts are loaded the first time a request uses them and stay loaded
+- empty lines and lines starting with # are ignored
+
+Responses are written in request order, a request ends with either a done or an error line:
+glyph <id> <code point> <width> <height> <byte count>\n followed by the byte count bytes of the image
+missing <id> <code point>\n
+done <id> <glyph count> <missing count> <microseconds>\n
+error <id> <message>\n
+
+Images are uncompressed. The duration goes from reading the request to writing its last image.
+*/
+
+// max. length of a request line, in bytes
+#define RENDER_SERVER_MAX_LINE 4096
+
+struct RenderOptions
+{
+	const Font* font;
+	u32 width;
+	u32 height;
+	f32 pixelsPerEm; // 0 to fit the glyphs to width*height
+	bool preserveAspect;
+	f32 subpixelX; // [0,1) pixels
+	f32 subpixelY; // [0,1) pixels
+	ImageFormat format;
+	RasterSettings raster;
+};
+
+// renders the requests read from an input stream on a pool of worker threads
+// - each worker has its own Rasterizer, the fonts are shared
+// - every glyph is a job, so a single big request also uses all the workers
+// - at most maxJobsInFlight jobs are in flight: reading requests stops until
+//   the oldest ones are written out
+// - a writer thread sends the results in request order
+// - the workers look the glyphs up in the shared glyph cache first, if there is one
+struct RenderServer
+{
+	RenderServer();
+	~RenderServer();
+
+	// sharedGlyphCache can be NULL
+	void Init(u32 threadCount, u32 maxJobsInFlight, FILE* outputFile, SharedGlyphCache* sharedGlyphCache);
+
+	// processes requests until the end of the input or 'quit'
+	// defaults.font is used by the requests without -font and can be NULL
+	// returns the number of requests that failed
+	u32 Run(FILE* input, const RenderOptions& defaults);
+
+	// waits for all pending jobs and stops the threads
+	void Finish();
+
+	enum JobType
+	{
+		JOB_GLYPH,
+		JOB_MISSING,
+		JOB_DONE,
+		JOB_ERROR
+	};
+
+	struct Request
+	{
+		std::string id;
+		RenderOptions options;
+		u32 glyphCount;
+		u32 missingCount;
+		s64 startTime;
+	};
+
+	struct Job
+	{
+		JobType type;
+		Request* request; // owned by the request's last job
+		const SluggishCodePoint* cp;
+		u32 codePoint;
+		u32 width;
+		u32 height;
+		std::vector<u8> image; // header and pixels
+		std::string message;
+		bool ready;
+	};
+
+	bool ParseRequest(Request& request, std::vector<u32>& codePoints, char* line, std::string& error);
+	const Font* GetFont(const char* filePath);
+	void PushJob(Job* job);
+	void WorkerThread();
+	void WriterThread();
+	void WriteJob(const Job& job);
+
+	std::unordered_map<std::string, Font*> fonts; // the ones we loaded, main thread only
+	std::deque<Job*> jobs; // in request order
+	std::deque<Job*> pendingJobs; // not rendered yet
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobReady;
+	std::condition_variable slotAvailable;
+	std::vector<std::thread> workers;
+	std::thread writer;
+	FILE* output;
+	SharedGlyphCache* sharedCache;
+	u32 queueDepth;
+	bool quit;
+};
@@ -0,0 +1,435 @@
+#include "shared_glyph_cache.hpp"
+
+#include <Windows.h>
+#include <string.h>
+
+
+#define SHARED_GLYPH_CACHE_MAGIC	0x434C4753 // "SGLC"
+#define SHARED_GLYPH_CACHE_VERSION	3
+
+// the slots start at this offset and are aligned to cache lines
+#define HEADER_BYTES	64
+#define SLOT_ALIGNMENT	64
+
+static_assert(sizeof(SharedGlyphCacheHeader) <= HEADER_BYTES, "The shared glyph cache header doesn't fit");
+
+
+static u32 GetSequence(u64 lock)
+{
+	return (u32)(lock & 0xFFFFFFFF);
+}
+
+static u64 MakeLock(u32 sequence, u32 tick)
+{
+	return (u64)sequence | ((u64)tick << 32);
+}
+
+static u64 ComputeChecksum(u64 fontHash, u64 key, const u8* data, u32 bytes)
+{
+	u64 hash = fontHash ^ (key * 0x9E3779B97F4A7C15ull) ^ (u64)bytes;
+	u32 i = 0;
+	for(; i + 8 <= bytes; i += 8)
+	{
+		u64 word;
+		memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 32;
+	}
+
+	for(; i < bytes; ++i)
+	{
+		hash = (hash ^ (u64)data[i]) * 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 32;
+	}
+
+	return hash;
+}
+
+// the field index keeps the same bits in different fields from hashing the same
+static u64 MixFloat(u64 hash, u32 field, f32 value)
+{
+	u32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	hash = (hash ^ (((u64)field << 32) | (u64)bits)) * 0x9E3779B97F4A7C15ull;
+	hash ^= hash >> 31;
+
+	return hash;
+}
+
+static void* MapFile(HANDLE file, u64 bytes, HANDLE* mapping)
+{
+	// the file grows to the requested size and the new bytes are zeroes
+	*mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)(bytes >> 32), (DWORD)(bytes & 0xFFFFFFFF), NULL);
+	if(*mapping == NULL)
+	{
+		return NULL;
+	}
+
+	void* const view = MapViewOfFile(*mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)bytes);
+	if(view == NULL)
+	{
+		CloseHandle(*mapping);
+		*mapping = NULL;
+	}
+
+	return view;
+}
+
+
+SharedGlyphCache::SharedGlyphCache() : header(NULL), fileHandle(NULL), mappingHandle(NULL)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+SharedGlyphCache::~SharedGlyphCache()
+{
+	Close();
+}
+
+bool SharedGlyphCache::Open(const char* filePath, uptr maxBytes, u32 slotBytes)
+{
+	Close();
+	memset(&stats, 0, sizeof(stats));
+
+	const HANDLE file = CreateFileA(filePath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		PrintError("Failed to open the shared glyph cache file: %s\n", filePath);
+		return false;
+	}
+	fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(file, &fileSize))
+	{
+		PrintError("Failed to get the size of the shared glyph cache file: %s\n", filePath);
+		Close();
+		return false;
+	}
+
+	// we're probably the first process: size the file ourselves
+	// if another process beats us to the initialization, we'll go with its layout instead
+	const u32 slotStride = ((u32)sizeof(SharedGlyphCacheSlot) + slotBytes + SLOT_ALIGNMENT - 1) & ~(u32)(SLOT_ALIGNMENT - 1);
+	u64 mappingBytes = (u64)fileSize.QuadPart;
+	if(mappingBytes == 0)
+	{
+		const u64 slotCount = maxBytes > HEADER_BYTES ? (((u64)maxBytes - HEADER_BYTES) / slotStride) & ~(u64)(SHARED_GLYPH_CACHE_WAYS - 1) : 0;
+		if(slotCount == 0 || slotCount > 0xFFFFFFFF)
+		{
+			PrintError("Invalid shared glyph cache size (%llu bytes for slots of %u bytes): %s\n", (unsigned long long)maxBytes, slotBytes, filePath);
+			Close();
+			return false;
+		}
+
+		mappingBytes = HEADER_BYTES + slotCount * (u64)slotStride;
+	}
+	else if(mappingBytes < HEADER_BYTES)
+	{
+		PrintError("Invalid shared glyph cache file: %s\n", filePath);
+		Close();
+		return false;
+	}
+
+	HANDLE mapping = NULL;
+	header = (SharedGlyphCacheHeader*)MapFile(file, mappingBytes, &mapping);
+	mappingHandle = mapping;
+	if(header == NULL)
+	{
+		PrintError("Failed to map the shared glyph cache file: %s\n", filePath);
+		Close();
+		return false;
+	}
+
+	u32 state = 0;
+	if(header->state.compare_exchange_strong(state, 1))
+	{
+		header->magic = SHARED_GLYPH_CACHE_MAGIC;
+		header->version = SHARED_GLYPH_CACHE_VERSION;
+		header->slotCount = (u32)((mappingBytes - HEADER_BYTES) / slotStride) & ~(u32)(SHARED_GLYPH_CACHE_WAYS - 1);
+		header->slotBytes = slotStride - (u32)sizeof(SharedGlyphCacheSlot);
+		header->slotStride = slotStride;
+		header->state.store(2);
+	}
+	else
+	{
+		// another process is initializing it
+		for(u32 i = 0; header->state.load() != 2; ++i)
+		{
+			if(i == 1000)
+			{
+				PrintError("The shared glyph cache file never got initialized, delete it and try again: %s\n", filePath);
+				Close();
+				return false;
+			}
+			Sleep(1);
+		}
+	}
+
+	if(header->magic != SHARED_GLYPH_CACHE_MAGIC || header->version != SHARED_GLYPH_CACHE_VERSION ||
+	   header->slotCount == 0 || header->slotCount % SHARED_GLYPH_CACHE_WAYS != 0 ||
+	   header->slotStride < sizeof(SharedGlyphCacheSlot) + header->slotBytes || header->slotStride % SLOT_ALIGNMENT != 0)
+	{
+		PrintError("Invalid or outdated shared glyph cache file, delete it and try again: %s\n", filePath);
+		Close();
+		return false;
+	}
+
+	// the process that initialized the file might have made it bigger than our view
+	const u64 usedBytes = HEADER_BYTES + (u64)header->slotCount * (u64)header->slotStride;
+	if(usedBytes > mappingBytes)
+	{
+		UnmapViewOfFile(header);
+		CloseHandle(mappingHandle);
+		header = (SharedGlyphCacheHeader*)MapFile(file, usedBytes, &mapping);
+		mappingHandle = mapping;
+		if(header == NULL)
+		{
+			PrintError("Failed to map the shared glyph cache file: %s\n", filePath);
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void SharedGlyphCache::Close()
+{
+	if(header != NULL)
+	{
+		header->hits += stats.hits;
+		header->misses += stats.misses;
+		UnmapViewOfFile(header);
+		header = NULL;
+	}
+
+	if(mappingHandle != NULL)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+
+	if(fileHandle != NULL)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = NULL;
+	}
+}
+
+bool SharedGlyphCache::IsEnabled() const
+{
+	return header != NULL;
+}
+
+bool SharedGlyphCache::Find(u64 fontHash, u64 key, u8* data, u32 bytes, SharedGlyphCacheStats& threadStats)
+{
+	if(header == NULL || key == 0)
+	{
+		return false;
+	}
+
+	const u32 firstSlot = GetFirstSlot(fontHash, key);
+	for(u32 i = 0; i < SHARED_GLYPH_CACHE_WAYS && bytes <= header->slotBytes; ++i)
+	{
+		SharedGlyphCacheSlot* const slot = GetSlot(firstSlot + i);
+		const u64 lock = slot->lock.load(std::memory_order_acquire);
+		if((GetSequence(lock) & 1) != 0 || slot->key != key || slot->fontHash != fontHash || slot->bytes != bytes)
+		{
+			continue;
+		}
+
+		// only keep the copy if no writer got in the way
+		const u64 checksum = slot->checksum;
+		memcpy(data, (const u8*)(slot + 1), (size_t)bytes);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(slot->lock.load(std::memory_order_relaxed) != lock)
+		{
+			continue;
+		}
+
+		// a writer whose slot got taken over mixed its data in: clear the key so that the glyph gets inserted again
+		if(ComputeChecksum(fontHash, key, data, bytes) != checksum)
+		{
+			u64 expected = lock;
+			if(slot->lock.compare_exchange_strong(expected, MakeLock(GetSequence(lock) + 1, (u32)GetTickCount64())))
+			{
+				slot->key = 0;
+				slot->lock.store(MakeLock(GetSequence(lock) + 2, 0), std::memory_order_release);
+			}
+			++threadStats.mismatches;
+			continue;
+		}
+
+		// only touch the slot's cache line when the tick changed
+		const u64 now = GetTickCount64();
+		if(slot->lastUse.load(std::memory_order_relaxed) != now)
+		{
+			slot->lastUse.store(now, std::memory_order_relaxed);
+		}
+		++threadStats.hits;
+		return true;
+	}
+
+	++threadStats.misses;
+
+	return false;
+}
+
+void SharedGlyphCache::Insert(u64 fontHash, u64 key, const u8* data, u32 bytes, SharedGlyphCacheStats& threadStats)
+{
+	if(header == NULL || key == 0)
+	{
+		return;
+	}
+
+	if(bytes > header->slotBytes)
+	{
+		++threadStats.rejections;
+		return;
+	}
+
+	// another process might have inserted it in the meantime
+	// if not, we take an empty slot, a locked one that might have been abandoned or evict the least recently used one
+	const u32 firstSlot = GetFirstSlot(fontHash, key);
+	SharedGlyphCacheSlot* target = NULL;
+	u64 oldestUse = ~(u64)0;
+	for(u32 i = 0; i < SHARED_GLYPH_CACHE_WAYS; ++i)
+	{
+		SharedGlyphCacheSlot* const slot = GetSlot(firstSlot + i);
+		const bool locked = (GetSequence(slot->lock.load(std::memory_order_relaxed)) & 1) != 0;
+		if(!locked && slot->key == key && slot->fontHash == fontHash && slot->bytes == bytes)
+		{
+			return;
+		}
+
+		const u64 lastUse = (slot->key == 0 || locked) ? 0 : slot->lastUse.load(std::memory_order_relaxed);
+		if(target == NULL || lastUse < oldestUse)
+		{
+			target = slot;
+			oldestUse = lastUse;
+		}
+	}
+
+	// computed before taking the lock to keep the slot locked for as short as possible
+	const u64 checksum = ComputeChecksum(fontHash, key, data, bytes);
+
+	// the tick wraps around every 49 days, which the unsigned difference handles
+	const u64 now = GetTickCount64();
+	const u32 tick = (u32)now;
+	u64 lock = target->lock.load();
+	const u32 sequence = GetSequence(lock);
+	const bool abandoned = (sequence & 1) != 0 && tick - (u32)(lock >> 32) > SHARED_GLYPH_CACHE_ABANDONED_MS;
+	if((sequence & 1) != 0 && !abandoned)
+	{
+		++threadStats.collisions;
+		return;
+	}
+
+	// taking an abandoned slot over keeps it locked under a new sequence
+	const u32 lockedSequence = abandoned ? sequence + 2 : sequence + 1;
+	const u64 lockedLock = MakeLock(lockedSequence, tick);
+	if(!target->lock.compare_exchange_strong(lock, lockedLock))
+	{
+		++threadStats.collisions;
+		return;
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+
+	if(abandoned)
+	{
+		++threadStats.takeovers;
+	}
+
+	if(target->key != 0)
+	{
+		++threadStats.evictions;
+	}
+
+	target->key = key;
+	target->fontHash = fontHash;
+	target->bytes = bytes;
+	target->checksum = checksum;
+	memcpy((u8*)(target + 1), data, (size_t)bytes);
+	target->lastUse.store(now, std::memory_order_relaxed);
+	// a writer that stalled for so long that its slot got taken over doesn't get to unlock it
+	// the stores above might have landed after the new owner published the slot,
+	// in which case the readers will find that the data doesn't match the checksum
+	u64 expected = lockedLock;
+	if(target->lock.compare_exchange_strong(expected, MakeLock(lockedSequence + 1, 0), std::memory_order_release))
+	{
+		++threadStats.insertions;
+	}
+	else
+	{
+		++threadStats.collisions;
+	}
+}
+
+void SharedGlyphCache::AddStats(const SharedGlyphCacheStats& threadStats)
+{
+	stats.hits += threadStats.hits;
+	stats.misses += threadStats.misses;
+	stats.insertions += threadStats.insertions;
+	stats.evictions += threadStats.evictions;
+	stats.rejections += threadStats.rejections;
+	stats.collisions += threadStats.collisions;
+	stats.takeovers += threadStats.takeovers;
+	stats.mismatches += threadStats.mismatches;
+}
+
+void SharedGlyphCache::PrintStats() const
+{
+	const u64 lookups = stats.hits + stats.misses;
+	const f64 hitRate = lookups > 0 ? (100.0 * (f64)stats.hits / (f64)lookups) : 0.0;
+	PrintInfo("Shared glyph cache: %llu hits, %llu misses (%.1f%% hit rate)\n",
+			  (unsigned long long)stats.hits, (unsigned long long)stats.misses, hitRate);
+	PrintInfo("Shared glyph cache: %llu insertions, %llu evictions, %llu rejections, %llu collisions, %llu takeovers, %llu mismatches\n",
+			  (unsigned long long)stats.insertions, (unsigned long long)stats.evictions, (unsigned long long)stats.rejections,
+			  (unsigned long long)stats.collisions, (unsigned long long)stats.takeovers, (unsigned long long)stats.mismatches);
+
+	// our own lookups only get added when we close the file
+	if(header != NULL)
+	{
+		const u64 allHits = header->hits.load() + stats.hits;
+		const u64 allLookups = allHits + header->misses.load() + stats.misses;
+		const f64 allHitRate = allLookups > 0 ? (100.0 * (f64)allHits / (f64)allLookups) : 0.0;
+		PrintInfo("Shared glyph cache: %.1f%% hit rate across all processes, %u slots of %u bytes\n",
+				  allHitRate, header->slotCount, header->slotBytes);
+	}
+}
+
+SharedGlyphCacheSlot* SharedGlyphCache::GetSlot(u32 index) const
+{
+	return (SharedGlyphCacheSlot*)((u8*)header + HEADER_BYTES + (uptr)index * (uptr)header->slotStride);
+}
+
+u32 SharedGlyphCache::GetFirstSlot(u64 fontHash, u64 key) const
+{
+	u64 hash = fontHash ^ (key * 0x9E3779B97F4A7C15ull);
+	hash ^= hash >> 31;
+	const u32 bucketCount = header->slotCount / SHARED_GLYPH_CACHE_WAYS;
+
+	return (u32)(hash % (u64)bucketCount) * SHARED_GLYPH_CACHE_WAYS;
+}
+
+u64 SharedGlyphCache::MakeFontHash(u64 fontHash, const RasterSettings& raster, f32 pixelsPerEm, f32 subpixelX, f32 subpixelY)
+{
+	u64 hash = fontHash;
+	if(raster.aaMode == AA_MODE_ADAPTIVE)
+	{
+		hash = MixFloat(hash, 1, raster.aaThreshold);
+	}
+
+	if(pixelsPerEm > 0.0f)
+	{
+		hash = MixFloat(hash, 2, pixelsPerEm);
+	}
+
+	if(subpixelX != 0.0f || subpixelY != 0.0f)
+	{
+		hash = MixFloat(hash, 3, subpixelX);
+		hash = MixFloat(hash, 4, subpixelY);
+	}
+
+	return hash;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+
+#include "../sluggish/rasterizer.hpp"
+#include "../shared.hpp"
+
+#include <atomic>
+
+
+// a given glyph can only go into one of this many slots
+#define SHARED_GLYPH_CACHE_WAYS 4
+
+// a slot locked for longer than this belongs to a writer that died, so the next insertion takes it over
+#define SHARED_GLYPH_CACHE_ABANDONED_MS 1000
+
+struct SharedGlyphCacheStats
+{
+	u64 hits;
+	u64 misses;
+	u64 insertions;
+	u64 evictions;
+	u64 rejections; // entries bigger than a slot
+	u64 collisions; // insertions dropped because another process was writing the slot
+	u64 takeovers; // insertions into slots left locked by a writer that died
+	u64 mismatches; // hits dropped because the data didn't match its checksum
+};
+
+// lives at the start of the mapped file, followed by the slots
+struct SharedGlyphCacheHeader
+{
+	std::atomic<u32> state; // 0: new file, 1: being initialized, 2: ready
+	u32 magic;
+	u32 version;
+	u32 slotCount;
+	u32 slotBytes; // max. size of a coverage mask
+	u32 slotStride;
+	std::atomic<u64> hits; // all processes, added when they close the file
+	std::atomic<u64> misses; // all processes, added when they close the file
+};
+
+// every slot is guarded by a sequence lock:
+// the sequence is odd while a writer owns the slot and readers retry elsewhere
+// when it changes while they copy the data out
+// the lock's high 32 bits hold the millisecond tick at which the writer took it
+// a writer whose slot got taken over can still be storing into it after it got published again,
+// so the readers also check the data against its checksum
+struct SharedGlyphCacheSlot
+{
+	std::atomic<u64> lock; // sequence | (lock tick << 32)
+	u32 bytes;
+	u64 fontHash;
+	u64 key;
+	u64 checksum; // of fontHash, key, bytes and the data
+	std::atomic<u64> lastUse; // millisecond tick, drives the eviction
+	// followed by slotBytes bytes of data
+};
+
+// coverage masks shared by all the processes mapping the same file
+// - lookups never block: a slot being written is treated as a miss
+// - lookups don't write to the header: the hit and miss counts are added when closing the file
+// - insertions never block either: they're dropped when the slot is busy
+// - each key maps to SHARED_GLYPH_CACHE_WAYS slots and the least recently used one gets evicted
+// - the first process to map the file decides the slot count and size
+// - any number of threads can look up and insert at the same time, each counting into its own stats
+struct SharedGlyphCache
+{
+	SharedGlyphCache();
+	~SharedGlyphCache();
+
+	// maxBytes and slotBytes are only used when the file doesn't exist yet
+	bool Open(const char* filePath, uptr maxBytes, u32 slotBytes);
+	void Close();
+	bool IsEnabled() const;
+
+	// copies the mask into data on a hit
+	bool Find(u64 fontHash, u64 key, u8* data, u32 bytes, SharedGlyphCacheStats& threadStats);
+	void Insert(u64 fontHash, u64 key, const u8* data, u32 bytes, SharedGlyphCacheStats& threadStats);
+	void AddStats(const SharedGlyphCacheStats& threadStats); // not thread-safe
+	void PrintStats() const;
+
+	// other processes might use other settings, so the ones that change the output
+	// without being part of the glyph cache key go into the font's identity
+	// pixelsPerEm is 0 when the glyphs are fitted to their image
+	static u64 MakeFontHash(u64 fontHash, const RasterSettings& raster, f32 pixelsPerEm, f32 subpixelX, f32 subpixelY);
+
+	SharedGlyphCacheSlot* GetSlot(u32 index) const;
+	u32 GetFirstSlot(u64 fontHash, u64 key) const;
+
+	SharedGlyphCacheHeader* header;
+	void* fileHandle;
+	void* mappingHandle;
+	SharedGlyphCacheStats stats; // this process only, since the last Open
+};
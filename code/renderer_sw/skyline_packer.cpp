@@ -0,0 +1,115 @@
+#include "skyline_packer.hpp"
+
+
+void SkylinePacker::Init(u32 w, u32 h)
+{
+	width = w;
+	maxHeight = h;
+	nodes.clear();
+
+	Node node;
+	node.x = 0;
+	node.y = 0;
+	node.width = w;
+	nodes.push_back(node);
+}
+
+bool SkylinePacker::Pack(u32 w, u32 h, u32* outX, u32* outY)
+{
+	if(w == 0 || h == 0 || w > width || h > maxHeight)
+	{
+		return false;
+	}
+
+	// find the spot that keeps the top edge the lowest, then the left-most one
+	size_t bestIdx = nodes.size();
+	u32 bestY = 0;
+	u32 bestTop = 0xFFFFFFFF;
+	for(size_t i = 0; i < nodes.size(); ++i)
+	{
+		const u32 x = nodes[i].x;
+		if(x + w > width)
+		{
+			break;
+		}
+
+		// the rectangle rests on the highest segment it spans
+		u32 y = 0;
+		u32 spanned = 0;
+		for(size_t j = i; j < nodes.size() && spanned < w; ++j)
+		{
+			y = Max(y, nodes[j].y);
+			spanned += nodes[j].width;
+		}
+
+		const u32 top = y + h;
+		if(top <= maxHeight && top < bestTop)
+		{
+			bestIdx = i;
+			bestY = y;
+			bestTop = top;
+		}
+	}
+
+	if(bestIdx == nodes.size())
+	{
+		return false;
+	}
+
+	Node node;
+	node.x = nodes[bestIdx].x;
+	node.y = bestTop;
+	node.width = w;
+	nodes.insert(nodes.begin() + bestIdx, node);
+
+	// shrink or remove the segments now covered by the new one
+	const u32 right = node.x + w;
+	for(size_t i = bestIdx + 1; i < nodes.size();)
+	{
+		Node& n = nodes[i];
+		if(n.x >= right)
+		{
+			break;
+		}
+
+		const u32 nRight = n.x + n.width;
+		if(nRight <= right)
+		{
+			nodes.erase(nodes.begin() + i);
+			continue;
+		}
+
+		n.width = nRight - right;
+		n.x = right;
+		break;
+	}
+
+	// merge neighbors at the same height
+	for(size_t i = 0; i + 1 < nodes.size();)
+	{
+		if(nodes[i].y == nodes[i + 1].y)
+		{
+			nodes[i].width += nodes[i + 1].width;
+			nodes.erase(nodes.begin() + i + 1);
+			continue;
+		}
+
+		++i;
+	}
+
+	*outX = node.x;
+	*outY = bestY;
+
+	return true;
+}
+
+u32 SkylinePacker::GetUsedHeight() const
+{
+	u32 h = 0;
+	for(const auto& n : nodes)
+	{
+		h = Max(h, n.y);
+	}
+
+	return h;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+
+#include "../shared.hpp"
+
+#include <vector>
+
+
+// bottom-left skyline rectangle packer
+// the results only depend on the sequence of Pack calls, which makes it deterministic
+struct SkylinePacker
+{
+	void Init(u32 width, u32 maxHeight);
+
+	// returns false when the rectangle can't fit anymore
+	bool Pack(u32 w, u32 h, u32* x, u32* y);
+
+	// the height of the tallest skyline segment
+	u32 GetUsedHeight() const;
+
+	struct Node
+	{
+		u32 x;
+		u32 y;
+		u32 width;
+	};
+
+	std::vector<Node> nodes; // sorted by x, no gaps
+	u32 width;
+	u32 maxHeight;
+};
@@ -1,4 +1,5 @@
 #include "shared.hpp"
+#include "sluggish/trace.hpp"
 
 #include <malloc.h>
 #include <stdarg.h>
@@ -28,8 +29,17 @@ bool AllocBuffer(Buffer& buffer, uptr bytes)
 	return true;
 }
 
+void FreeBuffer(Buffer& buffer)
+{
+	free(buffer.buffer);
+	buffer.buffer = NULL;
+	buffer.length = 0;
+}
+
 bool ReadEntireFile(Buffer& buffer, const char* filePath)
 {
+	TRACE_ZONE("ReadEntireFile");
+
 	FILE* file = fopen(filePath, "rb");
 	if(!file)
 	{
@@ -184,4 +194,17 @@ bool File::Read(void* data, size_t bytes)
 bool File::Write(const void* data, size_t bytes)
 {
 	return fwrite(data, bytes, 1, (FILE*)file) == 1;
+}
+
+bool File::Close()
+{
+	if(file == NULL)
+	{
+		return false;
+	}
+
+	const bool success = fclose((FILE*)file) == 0;
+	file = NULL;
+
+	return success;
 }
\ No newline at end of file
@@ -63,12 +63,14 @@ struct File
 	bool IsValid();
 	bool Read(void* data, size_t bytes);
 	bool Write(const void* data, size_t bytes);
+	bool Close(); // false when the buffered data couldn't be flushed
 
 	void* file;
 };
 
 f32 EvaluateQuadraticBezierCurve(f32 y1, f32 y2, f32 y3, f32 t);
 bool AllocBuffer(Buffer& buffer, uptr bytes);
+void FreeBuffer(Buffer& buffer);
 bool ReadEntireFile(Buffer& buffer, const char* filePath);
 void PrintInfo(const char* format, ...);
 void PrintWarning(const char* format, ...);
@@ -82,16 +84,28 @@ const char* GetExecutableFileName(char* argv0);
 Sluggish font file format
 
 SLUGGISH (8 bytes)
-# code points (u16)
+format version (u32)
+SluggishFontInfo
+# code points (u32)
 array of SluggishCodePoint
-curves texture width (u16)
-curves texture height (u16)
-curves texture bytes (u32)
+# curves texels (u32)
 curves texture data (RGBA 32f)
-bands texture width (u16)
-bands texture height (u16)
-bands texture bytes (u32)
+# bands texels (u32)
 bands texture data (RG 16)
+
+Both textures are 1D: everything is addressed with linear texel indices.
+Each glyph's data in the bands texture starts with its band headers [curve count, texel offset of the curve list]
+followed by its curve lists, where each entry is a curves texel index split into [low 16 bits, high 16 bits].
+The offset is relative to the glyph's SluggishCodePoint::bandsTexelIndex.
+
+With SLUGGISH_FLAG_INLINE_CURVES, the bands texture only has the band headers [curve count, curves texel offset]
+and each band's curves are stored contiguously in the curves texture as 2 texels: [x1 y1 x2 y2] [x3 y3 0 0].
+The offset is relative to the glyph's SluggishCodePoint::curvesTexelIndex.
+Curves crossing several bands get duplicated but the shader no longer needs a dependent fetch per curve.
+
+The curves' control points are relative to the bottom-left of the glyph's bounding box.
+They are in font units unless SLUGGISH_FLAG_NORMALIZED_CURVES is set,
+in which case they're divided by the glyph's width and height (i.e. the bounding box is [0,1]).
 */
 
 #define SLUGGISH_EXTENSION_NAME ".sluggish"
@@ -100,13 +114,27 @@ bands texture data (RG 16)
 #define SLUGGISH_HEADER_DATA "SLUGGISH"
 #define SLUGGISH_HEADER_LEN  8
 
-// if you change this, the pixel shader needs to change too
-#define TEXTURE_WIDTH  4096
-#define TEXTURE_MASK  0xFFF
-#define TEXTURE_SHIFT    12
+// bump this whenever the layout of the file changes
+#define SLUGGISH_VERSION 6
+
+// SluggishFontInfo::flags
+#define SLUGGISH_FLAG_NORMALIZED_CURVES 1
+#define SLUGGISH_FLAG_INLINE_CURVES     2
 
 #pragma pack(push, 1)
 
+// all values are in font units
+struct SluggishFontInfo
+{
+	s16 ascent;
+	s16 descent;
+	s16 lineGap;
+	u16 unitsPerEm;
+	u16 flags; // SLUGGISH_FLAG_*
+};
+
+// width, height, bearings and advance are in font units
+// the bearings are the offsets from the glyph's origin to the bottom-left of its bounding box
 struct SluggishCodePoint
 {
 	u32 codePoint;
@@ -115,9 +143,13 @@ struct SluggishCodePoint
 	u32 bandCount;
 	u32 bandDimX;
 	u32 bandDimY;
-	u16 bandsTexCoordX;
-	u16 bandsTexCoordY;
+	u32 bandsTexelIndex; // of the first band header
+	u32 curvesTexelIndex; // of the first inline curve, only used with SLUGGISH_FLAG_INLINE_CURVES
+	s16 bearingX;
+	s16 bearingY;
+	u16 advance;
 };
 
 #pragma pack(pop)
 
+
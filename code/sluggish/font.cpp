@@ -0,0 +1,456 @@
+#include "font.hpp"
+#include "trace.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+#define BANDS_TAG_1		0xAB
+#define BANDS_TAG_2		0xABAB
+#define CURVES_TAG_1	0xCD
+#define CURVES_TAG_4	0xCDCDCDCD
+
+
+#if defined(_DEBUG)
+static void CheckCurve(const u16* b, const f32* p12, const f32* p3)
+{
+	if(b[0] == BANDS_TAG_2 ||
+	   b[1] == BANDS_TAG_2)
+	{
+		PrintWarning("Uninitialized band used.\n");
+	}
+
+	u32 values[6];
+	memcpy(&values[0], p12, 4 * sizeof(f32));
+	memcpy(&values[4], p3, 2 * sizeof(f32));
+	for(int i = 0; i < 6; ++i)
+	{
+		if(values[i] == CURVES_TAG_4)
+		{
+			PrintWarning("Uninitialized curve used.\n");
+			break;
+		}
+	}
+}
+#define CHECK_CURVE(b, p12, p3) CheckCurve(b, p12, p3)
+#else
+#define CHECK_CURVE(b, p12, p3) ((void)0)
+#endif
+
+
+// 64-bit FNV-1a
+static u64 HashBytes(u64 hash, const void* data, size_t bytes)
+{
+	const u8* const d = (const u8*)data;
+	for(size_t i = 0; i < bytes; ++i)
+	{
+		hash = (hash ^ (u64)d[i]) * 1099511628211ull;
+	}
+
+	return hash;
+}
+
+// converts the curves of every glyph from font units to the glyph's unit box (normalize) or back
+// returns false when the data references texels that don't exist
+static bool ScaleGlyphCurves(std::vector<f32>& curves, const std::vector<u16>& bands, const std::vector<SluggishCodePoint>& codePoints, u32 flags, bool normalize)
+{
+	TRACE_ZONE("ScaleGlyphCurves");
+
+	const bool inlineCurves = (flags & SLUGGISH_FLAG_INLINE_CURVES) != 0;
+	const u32 curvesTexels = (u32)(curves.size() / 4);
+	const u32 bandsTexels = (u32)(bands.size() / 2);
+
+	// a texel only ever belongs to a single glyph but many bands can reference it,
+	// so we find the glyph's texels through its bands and make sure to scale each one only once
+	std::vector<u8> scaled((size_t)curvesTexels, 0);
+	for(const auto& cp : codePoints)
+	{
+		const f32 w = (f32)Max(cp.width, 1u);
+		const f32 h = (f32)Max(cp.height, 1u);
+		const f32 scaleX = normalize ? (1.0f / w) : w;
+		const f32 scaleY = normalize ? (1.0f / h) : h;
+
+		// horizontal bands followed by vertical bands
+		for(u32 b = 0; b < 2 * cp.bandCount; ++b)
+		{
+			const u32 header = cp.bandsTexelIndex + b;
+			if(header >= bandsTexels)
+			{
+				return false;
+			}
+
+			const u32 curveCount = (u32)bands[2 * header + 0];
+			const u32 curveList = (u32)bands[2 * header + 1];
+			if(!inlineCurves && cp.bandsTexelIndex + curveList + curveCount > bandsTexels)
+			{
+				return false;
+			}
+
+			for(u32 c = 0; c < curveCount; ++c)
+			{
+				u32 curveTexel;
+				if(inlineCurves)
+				{
+					curveTexel = cp.curvesTexelIndex + curveList + 2 * c;
+				}
+				else
+				{
+					const u16* const ref = &bands[2 * (cp.bandsTexelIndex + curveList + c)];
+					curveTexel = (u32)ref[0] | ((u32)ref[1] << 16);
+				}
+
+				if(curveTexel + 1 >= curvesTexels)
+				{
+					return false;
+				}
+
+				// [x1 y1 x2 y2] [x3 y3 ...]
+				for(u32 t = curveTexel; t <= curveTexel + 1; ++t)
+				{
+					if(scaled[t])
+					{
+						continue;
+					}
+
+					f32* const texel = &curves[4 * (size_t)t];
+					texel[0] *= scaleX;
+					texel[1] *= scaleY;
+					texel[2] *= scaleX;
+					texel[3] *= scaleY;
+					if(!normalize)
+					{
+						// font unit coordinates are integers or midpoints of integers:
+						// snapping them gets rid of the round trip's error, which would otherwise
+						// flip the curve classification of samples that land exactly on a vertex
+						for(int v = 0; v < 4; ++v)
+						{
+							texel[v] = floorf(texel[v] * 2.0f + 0.5f) * 0.5f;
+						}
+					}
+					scaled[t] = 1;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+// the curves must be in font units
+// returns false when the data references texels that don't exist
+static bool BuildBandCurves(FontBandCurves& bandCurves, const std::vector<f32>& curves, const std::vector<u16>& bands, const std::vector<SluggishCodePoint>& codePoints, u32 flags)
+{
+	TRACE_ZONE("BuildBandCurves");
+
+	const bool inlineCurves = (flags & SLUGGISH_FLAG_INLINE_CURVES) != 0;
+	const u32 curvesTexels = (u32)(curves.size() / 4);
+	const u32 bandsTexels = (u32)(bands.size() / 2);
+	const u32 alignment = (u32)BAND_CURVES_ALIGNMENT_FLOATS;
+
+	// 1st pass: validate everything and figure out the sizes
+	u32 bandCount = 0;
+	u32 curveSlots = 0;
+	for(const auto& cp : codePoints)
+	{
+		bandCount = Max(bandCount, cp.bandsTexelIndex + 2 * cp.bandCount);
+		if(bandCount > bandsTexels)
+		{
+			return false;
+		}
+
+		for(u32 b = 0; b < 2 * cp.bandCount; ++b)
+		{
+			const u16* const band = &bands[2 * (cp.bandsTexelIndex + b)];
+			if(!inlineCurves && cp.bandsTexelIndex + (u32)band[1] + (u32)band[0] > bandsTexels)
+			{
+				return false;
+			}
+
+			curveSlots += ((u32)band[0] + alignment - 1) & ~(alignment - 1);
+		}
+	}
+
+	const size_t arrayBytes = (size_t)curveSlots * sizeof(f32);
+	if(!AllocBuffer(bandCurves.memory, (uptr)(7 * arrayBytes + BAND_CURVES_ALIGNMENT)))
+	{
+		return false;
+	}
+
+	memset(bandCurves.memory.buffer, 0, (size_t)bandCurves.memory.length);
+	f32* const base = (f32*)(((uptr)bandCurves.memory.buffer + BAND_CURVES_ALIGNMENT - 1) & ~(uptr)(BAND_CURVES_ALIGNMENT - 1));
+	bandCurves.x1 = base + 0 * (size_t)curveSlots;
+	bandCurves.y1 = base + 1 * (size_t)curveSlots;
+	bandCurves.x2 = base + 2 * (size_t)curveSlots;
+	bandCurves.y2 = base + 3 * (size_t)curveSlots;
+	bandCurves.x3 = base + 4 * (size_t)curveSlots;
+	bandCurves.y3 = base + 5 * (size_t)curveSlots;
+	bandCurves.maxX = base + 6 * (size_t)curveSlots;
+	bandCurves.bands.assign((size_t)bandCount, FontBandSpan());
+
+	// 2nd pass: copy the curves over, band by band
+	u32 slot = 0;
+	for(const auto& cp : codePoints)
+	{
+		for(u32 b = 0; b < 2 * cp.bandCount; ++b)
+		{
+			const bool vertical = b >= cp.bandCount;
+			const u16* const band = &bands[2 * (cp.bandsTexelIndex + b)];
+			FontBandSpan& span = bandCurves.bands[cp.bandsTexelIndex + b];
+			span.firstCurve = slot;
+			span.curveCount = band[0];
+
+			for(u32 c = 0; c < (u32)band[0]; ++c)
+			{
+				const u16 noRef[2] = { 0, 0 };
+				const u16* ref = noRef;
+				u32 curveTexel;
+				if(inlineCurves)
+				{
+					curveTexel = cp.curvesTexelIndex + band[1] + 2 * c;
+				}
+				else
+				{
+					ref = &bands[2 * (cp.bandsTexelIndex + band[1] + c)];
+					curveTexel = (u32)ref[0] | ((u32)ref[1] << 16);
+				}
+
+				if(curveTexel + 1 >= curvesTexels)
+				{
+					return false;
+				}
+
+				const f32* const p12 = &curves[4 * (size_t)curveTexel];
+				const f32* const p3 = p12 + 4;
+				CHECK_CURVE(ref, p12, p3);
+
+				const u32 i = slot + c;
+				bandCurves.x1[i] = vertical ? p12[1] : p12[0];
+				bandCurves.y1[i] = vertical ? p12[0] : p12[1];
+				bandCurves.x2[i] = vertical ? p12[3] : p12[2];
+				bandCurves.y2[i] = vertical ? p12[2] : p12[3];
+				bandCurves.x3[i] = vertical ? p3[1] : p3[0];
+				bandCurves.y3[i] = vertical ? p3[0] : p3[1];
+				bandCurves.maxX[i] = Max(bandCurves.x1[i], bandCurves.x2[i], bandCurves.x3[i]);
+			}
+
+			slot += ((u32)band[0] + alignment - 1) & ~(alignment - 1);
+		}
+	}
+
+	return true;
+}
+
+
+Font::Font() : hash(0)
+{
+	memset(&info, 0, sizeof(info));
+	memset(&bandCurves.memory, 0, sizeof(bandCurves.memory));
+}
+
+Font::~Font()
+{
+	Unload();
+}
+
+bool Font::Load(const char* filePath, u32 loadFlags)
+{
+	TRACE_ZONE("Font::Load");
+
+	Unload();
+
+	File file;
+	if(!file.Open(filePath, "rb"))
+	{
+		PrintError("Failed to open font file: %s\n", filePath);
+		return false;
+	}
+
+	char header[SLUGGISH_HEADER_LEN + 1];
+	file.Read(header, SLUGGISH_HEADER_LEN);
+	header[SLUGGISH_HEADER_LEN] = '\0';
+	if(strcmp(header, SLUGGISH_HEADER_DATA) != 0)
+	{
+		PrintError("Invalid header found (%s instead of %s): %s\n", header, SLUGGISH_HEADER_DATA, filePath);
+		return false;
+	}
+
+	u32 version = 0;
+	file.Read(&version, sizeof(version));
+	if(version != SLUGGISH_VERSION)
+	{
+		PrintError("Unsupported format version (%u instead of %u), the file must be regenerated: %s\n", (unsigned int)version, (unsigned int)SLUGGISH_VERSION, filePath);
+		return false;
+	}
+
+	file.Read(&info, sizeof(info));
+
+	u32 codePointCount = 0;
+	file.Read(&codePointCount, sizeof(codePointCount));
+	if(codePointCount == 0)
+	{
+		PrintError("No code points found: %s\n", filePath);
+		return false;
+	}
+
+	// Unicode doesn't have more
+	if(codePointCount > 0x110000)
+	{
+		PrintError("Invalid code point count (%u): %s\n", (unsigned int)codePointCount, filePath);
+		return false;
+	}
+
+	codePoints.resize((size_t)codePointCount);
+	file.Read(&codePoints[0], codePoints.size() * sizeof(SluggishCodePoint));
+	for(u32 i = 0; i < codePointCount; ++i)
+	{
+		glyphIndices[codePoints[i].codePoint] = i;
+	}
+
+	u32 curvesTexels = 0;
+	file.Read(&curvesTexels, sizeof(curvesTexels));
+	if(curvesTexels == 0)
+	{
+		PrintError("Invalid curves texture size: %s\n", filePath);
+		return false;
+	}
+
+	curvesTexture.resize(4 * (size_t)curvesTexels);
+	memset(&curvesTexture[0], CURVES_TAG_1, curvesTexture.size() * sizeof(f32));
+	file.Read(&curvesTexture[0], curvesTexture.size() * sizeof(f32));
+
+	u32 bandsTexels = 0;
+	file.Read(&bandsTexels, sizeof(bandsTexels));
+	if(bandsTexels == 0)
+	{
+		PrintError("Invalid bands texture size: %s\n", filePath);
+		return false;
+	}
+
+	bandsTexture.resize(2 * (size_t)bandsTexels);
+	memset(&bandsTexture[0], BANDS_TAG_1, bandsTexture.size() * sizeof(u16));
+	file.Read(&bandsTexture[0], bandsTexture.size() * sizeof(u16));
+
+	if(!Prepare(loadFlags))
+	{
+		PrintError("Invalid curve data: %s\n", filePath);
+		return false;
+	}
+
+	return true;
+}
+
+bool Font::Create(const SluggishFontInfo& fontInfo, const SluggishCodePoint* glyphs, u32 glyphCount, const f32* curves, u32 curvesTexels, const u16* bands, u32 bandsTexels, u32 loadFlags)
+{
+	Unload();
+
+	if(glyphCount == 0 || curvesTexels == 0 || bandsTexels == 0)
+	{
+		PrintError("No code points or curves to create a font from\n");
+		return false;
+	}
+
+	info = fontInfo;
+	codePoints.assign(glyphs, glyphs + glyphCount);
+	for(u32 i = 0; i < glyphCount; ++i)
+	{
+		glyphIndices[codePoints[i].codePoint] = i;
+	}
+	curvesTexture.assign(curves, curves + 4 * (size_t)curvesTexels);
+	bandsTexture.assign(bands, bands + 2 * (size_t)bandsTexels);
+
+	if(!Prepare(loadFlags))
+	{
+		PrintError("Invalid curve data\n");
+		return false;
+	}
+
+	return true;
+}
+
+// hashes the data read by Load or copied by Create and converts it as requested
+// returns false when the data references texels that don't exist
+bool Font::Prepare(u32 loadFlags)
+{
+	// hashing goes through all the data byte by byte, so only the users of the hash pay for it
+	if((loadFlags & FONT_LOAD_HASH) != 0)
+	{
+		TRACE_ZONE("Font::Load hash");
+		const u32 version = SLUGGISH_VERSION;
+		hash = HashBytes(14695981039346656037ull, &version, sizeof(version));
+		hash = HashBytes(hash, &info, sizeof(info));
+		hash = HashBytes(hash, &codePoints[0], codePoints.size() * sizeof(SluggishCodePoint));
+		hash = HashBytes(hash, &curvesTexture[0], curvesTexture.size() * sizeof(f32));
+		hash = HashBytes(hash, &bandsTexture[0], bandsTexture.size() * sizeof(u16));
+	}
+
+	// the CPU traces in font units and the GPU in the glyphs' unit box
+	bool normalized = (info.flags & SLUGGISH_FLAG_NORMALIZED_CURVES) != 0;
+	if((loadFlags & FONT_LOAD_BAND_CURVES) != 0)
+	{
+		if(normalized && !ScaleGlyphCurves(curvesTexture, bandsTexture, codePoints, info.flags, false))
+		{
+			return false;
+		}
+
+		normalized = false;
+		if(!BuildBandCurves(bandCurves, curvesTexture, bandsTexture, codePoints, info.flags))
+		{
+			return false;
+		}
+	}
+
+	if((loadFlags & FONT_LOAD_TEXTURES) != 0)
+	{
+		if(!normalized && !ScaleGlyphCurves(curvesTexture, bandsTexture, codePoints, info.flags, true))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		std::vector<f32>().swap(curvesTexture);
+		std::vector<u16>().swap(bandsTexture);
+	}
+
+	return true;
+}
+
+void Font::Unload()
+{
+	if(bandCurves.memory.buffer != NULL)
+	{
+		FreeBuffer(bandCurves.memory);
+	}
+
+	hash = 0;
+	bandCurves.bands.clear();
+	codePoints.clear();
+	glyphIndices.clear();
+	curvesTexture.clear();
+	bandsTexture.clear();
+}
+
+const SluggishCodePoint* Font::FindCodePoint(u32 codePoint) const
+{
+	const s32 index = FindGlyphIndex(codePoint);
+
+	return index >= 0 ? &codePoints[index] : NULL;
+}
+
+s32 Font::FindGlyphIndex(u32 codePoint) const
+{
+	const auto it = glyphIndices.find(codePoint);
+
+	return it != glyphIndices.end() ? (s32)it->second : -1;
+}
+
+void Font::GetMetrics(FontMetrics& metrics, f32 pixelsPerEm) const
+{
+	const f32 s = pixelsPerEm / (f32)info.unitsPerEm;
+	metrics.pixelsPerUnit = s;
+	metrics.ascent = (f32)info.ascent * s;
+	metrics.descent = (f32)info.descent * s;
+	metrics.lineGap = (f32)info.lineGap * s;
+	metrics.lineHeight = (f32)(info.ascent - info.descent + info.lineGap) * s;
+}
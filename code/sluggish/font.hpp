@@ -0,0 +1,87 @@
+#pragma once
+
+
+#include "../shared.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+
+// Font::Load flags
+#define FONT_LOAD_TEXTURES		1 // keeps the textures for the GPU, with the curves in the glyphs' unit box
+#define FONT_LOAD_BAND_CURVES	2 // builds the band curves used by Rasterizer
+#define FONT_LOAD_HASH			4 // computes Font::hash
+
+// every band's curves start on a boundary this big (bytes) in each of the FontBandCurves arrays
+#define BAND_CURVES_ALIGNMENT			32
+#define BAND_CURVES_ALIGNMENT_FLOATS	(BAND_CURVES_ALIGNMENT / sizeof(f32))
+
+struct FontBandSpan
+{
+	u32 firstCurve; // index into the FontBandCurves arrays
+	u32 curveCount;
+};
+
+// the CPU representation of the curves, built from the textures at load time
+// every band's curves are contiguous and each control point coordinate has its own array
+// the curves of vertical bands are stored with x and y swapped (i.e. in ray space)
+// so that tracing rays is done the same way for both axes
+// everything is in font units
+struct FontBandCurves
+{
+	std::vector<FontBandSpan> bands; // indexed like the band headers of the bands texture
+	Buffer memory;
+	f32* x1;
+	f32* y1;
+	f32* x2;
+	f32* y2;
+	f32* x3;
+	f32* y3;
+	f32* maxX; // Max(x1, x2, x3) for the early exit
+};
+
+// all values are in pixels
+struct FontMetrics
+{
+	f32 pixelsPerUnit; // font units to pixels
+	f32 ascent;
+	f32 descent;
+	f32 lineGap;
+	f32 lineHeight; // from one baseline to the next
+};
+
+// a .sluggish file loaded into memory
+// a loaded font is never modified, so any number of threads can use it at the same time
+struct Font
+{
+	Font();
+	~Font();
+
+	// loadFlags: FONT_LOAD_* flags
+	// returns false and prints why when the file can't be used
+	bool Load(const char* filePath, u32 loadFlags);
+	// same as Load but from textures laid out like a file's, which get copied
+	bool Create(const SluggishFontInfo& fontInfo, const SluggishCodePoint* glyphs, u32 glyphCount, const f32* curves, u32 curvesTexels, const u16* bands, u32 bandsTexels, u32 loadFlags);
+	void Unload();
+
+	// both return NULL/-1 when the font doesn't have the code point
+	const SluggishCodePoint* FindCodePoint(u32 codePoint) const;
+	s32 FindGlyphIndex(u32 codePoint) const;
+
+	void GetMetrics(FontMetrics& metrics, f32 pixelsPerEm) const;
+
+	u64 hash; // of the file's data, identifies the font across processes, FONT_LOAD_HASH only
+	SluggishFontInfo info; // the flags describe the file, not the textures below
+	std::vector<SluggishCodePoint> codePoints;
+	std::unordered_map<u32, u32> glyphIndices; // code point to index into codePoints
+	std::vector<f32> curvesTexture; // RGBA 32f texels, FONT_LOAD_TEXTURES only
+	std::vector<u16> bandsTexture; // RG 16 texels, FONT_LOAD_TEXTURES only
+	FontBandCurves bandCurves; // FONT_LOAD_BAND_CURVES only
+
+private:
+	bool Prepare(u32 loadFlags);
+
+	// we own the band curves' memory
+	Font(const Font&);
+	void operator=(const Font&);
+};
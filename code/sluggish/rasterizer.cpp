@@ -0,0 +1,312 @@
+#include "rasterizer.hpp"
+#include "trace.hpp"
+
+#include <string.h>
+#include <math.h>
+
+
+struct float2
+{
+	f32 x, y;
+};
+
+
+// traces a horizontal ray in ray space, i.e. (x0, y0) is swapped for the vertical bands
+static f32 TraceRayBand(const FontBandCurves& curves, const FontBandSpan& band, f32 x0, f32 y0, f32 pixelsPerEm)
+{
+	const f32* const x1 = curves.x1 + band.firstCurve;
+	const f32* const y1 = curves.y1 + band.firstCurve;
+	const f32* const x2 = curves.x2 + band.firstCurve;
+	const f32* const y2 = curves.y2 + band.firstCurve;
+	const f32* const x3 = curves.x3 + band.firstCurve;
+	const f32* const y3 = curves.y3 + band.firstCurve;
+	const f32* const maxX = curves.maxX + band.firstCurve;
+	f32 coverage = 0.0f;
+
+	// run an intersection test against every curve in the selected band
+	for(u32 curveIdx = 0; curveIdx < band.curveCount; ++curveIdx)
+	{
+		if((maxX[curveIdx] - x0) * pixelsPerEm < -0.5f)
+		{
+			// the rightmost coordinate of this curve is to the left of this pixel's
+			// this means means we have no more curves to intersect with
+			// since the curve data is sorted
+			break;
+		}
+
+		// compute the 3 curve points relative to the current pixel (x0, y0)
+		const float2 p1 = { x1[curveIdx] - x0, y1[curveIdx] - y0 };
+		const float2 p2 = { x2[curveIdx] - x0, y2[curveIdx] - y0 };
+		const float2 p3 = { x3[curveIdx] - x0, y3[curveIdx] - y0 };
+
+		// solve the quadratic equation: a*t*t - 2*b*t + c = 0
+		const f32 a = p1.y - 2.0f * p2.y + p3.y;
+		const f32 b = p1.y - p2.y;
+		const f32 c = p1.y;
+		f32 t1, t2;
+		if(fabsf(a) < 0.0001f)
+		{
+			// a is too close to 0, so we solve this linear equation instead: c - 2*b*t = 0
+			t1 = t2 = c / (2.0f * b);
+		}
+		else
+		{
+			// all is good, we find the 2 roots the usual way
+			const f32 rootArg = Max(b*b - a*c, 0.0f);
+			const f32 root = sqrtf(rootArg);
+			t1 = (b - root) / a;
+			t2 = (b + root) / a;
+		}
+
+		// generate the curve classification code and update the coverage accordingly
+		const uint input = ((p1.y > 0.0f) ? 2 : 0) + ((p2.y > 0.0f) ? 4 : 0) + ((p3.y > 0.0f) ? 8 : 0);
+		const uint output = 0x2E74 >> input;
+		if((output & 1) != 0)
+		{
+			const f32 r1 = EvaluateQuadraticBezierCurve(p1.x, p2.x, p3.x, t1);
+			coverage += Clamp(0.5f + r1 * pixelsPerEm, 0.0f, 1.0f);
+		}
+		if((output & 2) != 0)
+		{
+			const f32 r2 = EvaluateQuadraticBezierCurve(p1.x, p2.x, p3.x, t2);
+			coverage -= Clamp(0.5f + r2 * pixelsPerEm, 0.0f, 1.0f);
+		}
+	}
+
+	return coverage;
+}
+
+// looks up the band containing the em-space coordinate and traces a ray through it
+// returns the absolute coverage, clamped to [0,1]
+static f32 TraceRayH(const FontBandCurves& curves, const SluggishCodePoint& cp, f32 fx0, f32 fy0, f32 pixelsPerEm)
+{
+	const s32 bandIdx = (s32)(fy0 / (f32)cp.bandDimY);
+	if(bandIdx < 0 || bandIdx >= (s32)cp.bandCount)
+	{
+		return 0.0f;
+	}
+
+	const FontBandSpan& band = curves.bands[cp.bandsTexelIndex + bandIdx];
+
+	return Min(fabsf(TraceRayBand(curves, band, fx0, fy0, pixelsPerEm)), 1.0f);
+}
+
+static f32 TraceRayV(const FontBandCurves& curves, const SluggishCodePoint& cp, f32 fx0, f32 fy0, f32 pixelsPerEm)
+{
+	const s32 bandIdx = (s32)(fx0 / (f32)cp.bandDimX);
+	if(bandIdx < 0 || bandIdx >= (s32)cp.bandCount)
+	{
+		return 0.0f;
+	}
+
+	const FontBandSpan& band = curves.bands[cp.bandsTexelIndex + cp.bandCount + bandIdx];
+
+	return Min(fabsf(TraceRayBand(curves, band, fy0, fx0, pixelsPerEm)), 1.0f);
+}
+
+// traces rows [firstRow, firstRow + rowCount) of a w*h coverage mask
+// rows are numbered from the top, rowData receives rowCount*w bytes
+// scale: em-space units per pixel
+// offset: em-space coordinates of the bottom-left pixel
+// returns the number of rays traced
+template<AAMode mode>
+static u64 RasterizeGlyphRowsT(Rasterizer& rasterizer, const Font& font, const SluggishCodePoint& cp, u8* rowData, u32 w, u32 h, u32 firstRow, u32 rowCount, f32 scaleX, f32 scaleY, f32 offsetX, f32 offsetY)
+{
+	(void)rasterizer; // only the adaptive mode needs scratch memory
+	const FontBandCurves& curves = font.bandCurves;
+	const f32 pixelsPerEmX = 1.0f / scaleX;
+	const f32 pixelsPerEmY = 1.0f / scaleY;
+	u64 rayCount = 0;
+
+	memset(rowData, 0, (size_t)w * (size_t)rowCount);
+
+	const u32 bandCount = cp.bandCount;
+	for(u32 r = 0; r < rowCount; ++r)
+	{
+		// compute this pixel's Y coordinate in em-space
+		// compute horizontal band index
+		const u32 y = h - 1 - (firstRow + r);
+		const f32 fy0 = offsetY + (f32)y * scaleY;
+		const s32 hBandIdx = (s32)(fy0 / (f32)cp.bandDimY);
+		if(hBandIdx < 0 || hBandIdx >= (s32)cp.bandCount)
+		{
+			// no band contains any curve we could intersect
+			continue;
+		}
+
+		// locate the horizontal band's curves
+		const FontBandSpan& hBand = curves.bands[cp.bandsTexelIndex + hBandIdx];
+
+		u8* const row = rowData + (size_t)r * (size_t)w;
+		for(u32 x = 0; x < w; ++x)
+		{
+			// compute this pixel's X coordinate in em-space
+			// compute vertical band index
+			const f32 fx0 = offsetX + (f32)x * scaleX;
+			const s32 vBandIdx = (s32)(fx0 / (f32)cp.bandDimX);
+			if(vBandIdx < 0 || vBandIdx >= (s32)cp.bandCount)
+			{
+				// no band contains any curve we could intersect
+				continue;
+			}
+
+			f32 coverage = Min(fabsf(TraceRayBand(curves, hBand, fx0, fy0, pixelsPerEmX)), 1.0f);
+			if(mode == AA_MODE_2RAYS)
+			{
+				// trace a 2nd ray for cheap (but imperfect) AA
+				const FontBandSpan& vBand = curves.bands[cp.bandsTexelIndex + bandCount + vBandIdx];
+				const f32 coverageY = Min(fabsf(TraceRayBand(curves, vBand, fy0, fx0, pixelsPerEmY)), 1.0f);
+				coverage = (coverage + coverageY) * 0.5f;
+			}
+
+			row[x] = (u8)(coverage * 255.0f);
+		}
+
+		rayCount += (u64)w * (mode == AA_MODE_2RAYS ? 2 : 1);
+	}
+
+	return rayCount;
+}
+
+// a single horizontal ray per pixel where the coverage is flat,
+// a 2nd vertical ray near edges and 4 more rays where the first 2 disagree
+template<>
+u64 RasterizeGlyphRowsT<AA_MODE_ADAPTIVE>(Rasterizer& rasterizer, const Font& font, const SluggishCodePoint& cp, u8* rowData, u32 w, u32 h, u32 firstRow, u32 rowCount, f32 scaleX, f32 scaleY, f32 offsetX, f32 offsetY)
+{
+	const FontBandCurves& curves = font.bandCurves;
+	const f32 pixelsPerEmX = 1.0f / scaleX;
+	const f32 pixelsPerEmY = 1.0f / scaleY;
+	const f32 threshold = rasterizer.settings.aaThreshold;
+	const f32 flatEpsilon = 1.0f / 512.0f;
+	u64 rayCount = 0;
+
+	memset(rowData, 0, (size_t)w * (size_t)rowCount);
+
+	// horizontal ray coverage of the rows above, at and below the current one
+	// a pixel is flat when it and its 4 neighbors are all fully inside or fully outside
+	std::vector<f32>& rows = rasterizer.rows;
+	rows.assign(3 * (size_t)(w + 2), 0.0f);
+	f32* above = &rows[0] + 1;
+	f32* current = above + w + 2;
+	f32* below = current + w + 2;
+	const auto traceRow = [&](f32* dest, s32 y)
+	{
+		const f32 fy0 = offsetY + (f32)y * scaleY;
+		for(u32 x = 0; x < w; ++x)
+		{
+			dest[x] = TraceRayH(curves, cp, offsetX + (f32)x * scaleX, fy0, pixelsPerEmX);
+		}
+	};
+
+	// the rows just above and below the window are traced again by every call
+	// and aren't counted, so that the ray count doesn't depend on how the image gets split
+	const u32 firstY = h - 1 - firstRow;
+	traceRow(above, (s32)firstY + 1);
+	traceRow(current, (s32)firstY);
+	rayCount += (u64)w * (u64)rowCount;
+
+	for(u32 r = 0; r < rowCount; ++r)
+	{
+		const u32 y = h - 1 - (firstRow + r);
+		const f32 fy0 = offsetY + (f32)y * scaleY;
+		traceRow(below, (s32)y - 1);
+
+		u8* const row = rowData + (size_t)r * (size_t)w;
+		for(u32 x = 0; x < w; ++x)
+		{
+			const f32 fx0 = offsetX + (f32)x * scaleX;
+			const s32 vBandIdx = (s32)(fx0 / (f32)cp.bandDimX);
+			if(vBandIdx < 0 || vBandIdx >= (s32)cp.bandCount)
+			{
+				// no band contains any curve we could intersect
+				continue;
+			}
+
+			const f32 coverageH = current[x];
+			const bool inside = coverageH >= 1.0f - flatEpsilon;
+			const bool outside = coverageH <= flatEpsilon;
+			const bool flat =
+				(inside || outside) &&
+				current[(s32)x - 1] == coverageH && current[x + 1] == coverageH &&
+				above[x] == coverageH && below[x] == coverageH;
+			if(flat)
+			{
+				row[x] = (u8)(coverageH * 255.0f);
+				continue;
+			}
+
+			const f32 coverageV = TraceRayV(curves, cp, fx0, fy0, pixelsPerEmY);
+			++rayCount;
+			if(fabsf(coverageH - coverageV) <= threshold)
+			{
+				row[x] = (u8)((coverageH + coverageV) * 0.5f * 255.0f);
+				continue;
+			}
+
+			// the rays disagree: super-sample with 2 more rays per axis at +/- a quarter pixel
+			const f32 dx = 0.25f * scaleX;
+			const f32 dy = 0.25f * scaleY;
+			f32 coverage = coverageH + coverageV;
+			coverage += TraceRayH(curves, cp, fx0, fy0 - dy, pixelsPerEmX);
+			coverage += TraceRayH(curves, cp, fx0, fy0 + dy, pixelsPerEmX);
+			coverage += TraceRayV(curves, cp, fx0 - dx, fy0, pixelsPerEmY);
+			coverage += TraceRayV(curves, cp, fx0 + dx, fy0, pixelsPerEmY);
+			rayCount += 4;
+			row[x] = (u8)(coverage * (1.0f / 6.0f) * 255.0f);
+		}
+
+		f32* const temp = above;
+		above = current;
+		current = below;
+		below = temp;
+	}
+
+	return rayCount;
+}
+
+
+
+Rasterizer::Rasterizer()
+{
+	settings.aaMode = AA_MODE_2RAYS;
+	settings.aaThreshold = 0.25f;
+}
+
+u64 Rasterizer::RasterizeRows(const Font& font, const SluggishCodePoint& cp, u8* rowData, u32 w, u32 h, u32 firstRow, u32 rowCount, f32 scaleX, f32 scaleY, f32 offsetX, f32 offsetY)
+{
+	TRACE_ZONE("Rasterizer::RasterizeRows");
+
+	// the font wasn't loaded with FONT_LOAD_BAND_CURVES or the code point belongs to another font
+	if(font.bandCurves.bands.empty() || (size_t)cp.bandsTexelIndex + 2 * (size_t)cp.bandCount > font.bandCurves.bands.size())
+	{
+		return 0;
+	}
+
+	switch(settings.aaMode)
+	{
+		case AA_MODE_1RAY: return RasterizeGlyphRowsT<AA_MODE_1RAY>(*this, font, cp, rowData, w, h, firstRow, rowCount, scaleX, scaleY, offsetX, offsetY);
+		case AA_MODE_ADAPTIVE: return RasterizeGlyphRowsT<AA_MODE_ADAPTIVE>(*this, font, cp, rowData, w, h, firstRow, rowCount, scaleX, scaleY, offsetX, offsetY);
+		default: return RasterizeGlyphRowsT<AA_MODE_2RAYS>(*this, font, cp, rowData, w, h, firstRow, rowCount, scaleX, scaleY, offsetX, offsetY);
+	}
+}
+
+u64 Rasterizer::Rasterize(const Font& font, const SluggishCodePoint& cp, u8* imageData, u32 w, u32 h, f32 scaleX, f32 scaleY, f32 offsetX, f32 offsetY)
+{
+	return RasterizeRows(font, cp, imageData, w, h, 0, h, scaleX, scaleY, offsetX, offsetY);
+}
+
+void Rasterizer::ComputeGlyphTransform(const SluggishCodePoint& cp, u32 w, u32 h, bool preserveAspect, f32 subpixelX, f32 subpixelY,
+									   f32* scaleX, f32* scaleY, f32* offsetX, f32* offsetY)
+{
+	*scaleX = (f32)cp.width / (f32)w;
+	*scaleY = (f32)cp.height / (f32)h;
+	if(preserveAspect)
+	{
+		const f32 s = Max(*scaleX, *scaleY);
+		*scaleX = s;
+		*scaleY = s;
+	}
+
+	*offsetX = -*scaleX * subpixelX;
+	*offsetY = -*scaleY * subpixelY;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+
+#include "font.hpp"
+
+#include <vector>
+
+
+enum AAMode
+{
+	AA_MODE_1RAY,    // horizontal ray only
+	AA_MODE_2RAYS,   // horizontal and vertical rays, averaged
+	AA_MODE_ADAPTIVE // 1 ray in flat areas, 2 near edges, 6 where the first 2 disagree
+};
+
+struct RasterSettings
+{
+	AAMode aaMode;
+	f32 aaThreshold; // adaptive mode: max. coverage difference between the first 2 rays
+};
+
+// traces coverage masks of glyphs loaded with FONT_LOAD_BAND_CURVES
+// a rasterizer keeps scratch memory around, so each thread needs its own
+// any number of rasterizers can use the same font at the same time
+struct Rasterizer
+{
+	Rasterizer();
+
+	// traces rows [firstRow, firstRow + rowCount) of a w*h coverage mask
+	// rows are numbered from the top, rowData receives rowCount*w bytes
+	// scale: em-space units per pixel
+	// offset: em-space coordinates of the bottom-left pixel
+	// returns the number of rays traced, 0 when the font has no band curves for cp and rowData is left as is
+	// the adaptive mode also traces the rows just outside the window, those rays aren't counted
+	u64 RasterizeRows(const Font& font, const SluggishCodePoint& cp, u8* rowData, u32 w, u32 h, u32 firstRow, u32 rowCount, f32 scaleX, f32 scaleY, f32 offsetX, f32 offsetY);
+
+	// traces every pixel of a w*h coverage mask
+	// returns the number of rays traced
+	u64 Rasterize(const Font& font, const SluggishCodePoint& cp, u8* imageData, u32 w, u32 h, f32 scaleX, f32 scaleY, f32 offsetX, f32 offsetY);
+
+	// fits the glyph into a w*h image
+	// subpixelX and subpixelY are in [0,1) pixels and shift the glyph right and up
+	static void ComputeGlyphTransform(const SluggishCodePoint& cp, u32 w, u32 h, bool preserveAspect, f32 subpixelX, f32 subpixelY,
+									  f32* scaleX, f32* scaleY, f32* offsetX, f32* offsetY);
+
+	RasterSettings settings;
+	std::vector<f32> rows; // scratch memory of the adaptive mode
+};
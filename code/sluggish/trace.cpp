@@ -0,0 +1,259 @@
+#include "trace.hpp"
+
+#include <Windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+#if defined(_MSC_VER)
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+
+struct TraceEvent
+{
+	const char* name;
+	s64 start;
+	s64 end;
+};
+
+struct TraceThread
+{
+	std::mutex mutex; // taken by the recording thread and Trace_Close
+	const char* name;
+	std::vector<TraceEvent> events;
+	s64 firstStart;
+	s64 lastEnd;
+};
+
+// what the trace viewers show as a thread
+struct TraceLane
+{
+	const char* name;
+	u32 id;
+	s64 end;
+};
+
+// the threads' buffers are never freed: the threads can be gone by the time we write the file
+static std::mutex g_traceMutex;
+static std::vector<TraceThread*> g_traceThreads;
+static std::atomic<bool> g_traceEnabled(false);
+static std::string g_tracePath;
+static s64 g_traceStart = 0;
+static TRACE_THREAD_LOCAL TraceThread* t_traceThread = NULL;
+
+
+static s64 GetTraceTime()
+{
+	LARGE_INTEGER time;
+	QueryPerformanceCounter(&time);
+
+	return (s64)time.QuadPart;
+}
+
+static TraceThread* GetTraceThread()
+{
+	if(t_traceThread == NULL)
+	{
+		TraceThread* const thread = new TraceThread;
+		thread->name = NULL;
+		thread->firstStart = 0;
+		thread->lastEnd = 0;
+
+		std::lock_guard<std::mutex> lock(g_traceMutex);
+		g_traceThreads.push_back(thread);
+		t_traceThread = thread;
+	}
+
+	return t_traceThread;
+}
+
+#if defined(SLUGGISH_TRACE)
+static void CloseTraceAtExit()
+{
+	Trace_Close();
+}
+#endif
+
+bool Trace_Open(const char* filePath)
+{
+#if defined(SLUGGISH_TRACE)
+	// make sure we can write the file before recording anything
+	FILE* const file = fopen(filePath, "w");
+	if(file == NULL)
+	{
+		PrintError("Failed to open trace file: %s\n", filePath);
+		return false;
+	}
+	fclose(file);
+
+	g_tracePath = filePath;
+	g_traceStart = GetTraceTime();
+	g_traceEnabled = true;
+	Trace_SetThreadName("main");
+
+	// so that the early exits still get their trace
+	static bool atExitRegistered = false;
+	if(!atExitRegistered)
+	{
+		atexit(&CloseTraceAtExit);
+		atExitRegistered = true;
+	}
+
+	return true;
+#else
+	// stdout can carry binary data, e.g. fontrender -serve
+	fprintf(stderr, "WARNING: Tracing was compiled out (SLUGGISH_TRACE isn't defined), no trace will be written to: %s\n", filePath);
+
+	return false;
+#endif
+}
+
+bool Trace_Close()
+{
+	// the zones still being recorded check this while holding their thread's lock,
+	// so no new event can show up once we took it
+	if(!g_traceEnabled.exchange(false))
+	{
+		return true;
+	}
+
+	FILE* const file = fopen(g_tracePath.c_str(), "w");
+	if(file == NULL)
+	{
+		PrintError("Failed to open trace file: %s\n", g_tracePath.c_str());
+		return false;
+	}
+
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	const f64 usPerTick = 1000000.0 / (f64)freq.QuadPart;
+	const unsigned int pid = (unsigned int)GetCurrentProcessId();
+
+	std::lock_guard<std::mutex> lock(g_traceMutex);
+	std::vector<TraceThread*> threads;
+	for(TraceThread* thread : g_traceThreads)
+	{
+		std::lock_guard<std::mutex> threadLock(thread->mutex);
+		if(thread->events.empty())
+		{
+			continue;
+		}
+
+		// the outer zones get recorded after the ones they contain
+		thread->firstStart = thread->events[0].start;
+		thread->lastEnd = thread->events[0].end;
+		for(const TraceEvent& e : thread->events)
+		{
+			thread->firstStart = Min(thread->firstStart, e.start);
+			thread->lastEnd = Max(thread->lastEnd, e.end);
+		}
+		threads.push_back(thread);
+	}
+	std::stable_sort(std::begin(threads), std::end(threads), [](const TraceThread* a, const TraceThread* b) { return a->firstStart < b->firstStart; });
+
+	// threads with the same name that never ran at the same time share a lane
+	// e.g. the stream mode starts new workers for every strip
+	std::vector<TraceLane> lanes;
+	u64 eventCount = 0;
+	bool first = true;
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for(TraceThread* thread : threads)
+	{
+		TraceLane* lane = NULL;
+		for(TraceLane& l : lanes)
+		{
+			if(thread->name != NULL && l.name != NULL && strcmp(l.name, thread->name) == 0 && l.end <= thread->firstStart)
+			{
+				lane = &l;
+				break;
+			}
+		}
+
+		if(lane == NULL)
+		{
+			TraceLane newLane;
+			newLane.name = thread->name;
+			newLane.id = (u32)lanes.size() + 1;
+			newLane.end = 0;
+			lanes.push_back(newLane);
+			lane = &lanes.back();
+			if(lane->name != NULL)
+			{
+				fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+						first ? "" : ",\n", pid, lane->id, lane->name);
+				first = false;
+			}
+		}
+		lane->end = thread->lastEnd;
+
+		for(const TraceEvent& e : thread->events)
+		{
+			fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					first ? "" : ",\n", e.name, pid, lane->id,
+					(f64)(e.start - g_traceStart) * usPerTick, (f64)(e.end - e.start) * usPerTick);
+			first = false;
+		}
+
+		eventCount += (u64)thread->events.size();
+		std::vector<TraceEvent>().swap(thread->events);
+	}
+	fprintf(file, "\n]}\n");
+
+	const bool success = ferror(file) == 0;
+	if(fclose(file) != 0 || !success)
+	{
+		PrintError("Failed to write trace file: %s\n", g_tracePath.c_str());
+		return false;
+	}
+
+	fprintf(stderr, "Trace: %llu zones on %u threads written to '%s'\n", (unsigned long long)eventCount, (unsigned int)lanes.size(), g_tracePath.c_str());
+
+	return true;
+}
+
+void Trace_SetThreadName(const char* name)
+{
+	if(g_traceEnabled.load(std::memory_order_acquire))
+	{
+		TraceThread* const thread = GetTraceThread();
+		std::lock_guard<std::mutex> lock(thread->mutex);
+		if(g_traceEnabled.load(std::memory_order_relaxed))
+		{
+			thread->name = name;
+		}
+	}
+}
+
+TraceZone::TraceZone(const char* zoneName) : name(zoneName), start(0)
+{
+	if(g_traceEnabled.load(std::memory_order_relaxed))
+	{
+		start = GetTraceTime();
+	}
+}
+
+TraceZone::~TraceZone()
+{
+	if(start != 0 && g_traceEnabled.load(std::memory_order_acquire))
+	{
+		TraceEvent e;
+		e.name = name;
+		e.start = start;
+		e.end = GetTraceTime();
+		TraceThread* const thread = GetTraceThread();
+		std::lock_guard<std::mutex> lock(thread->mutex);
+		if(g_traceEnabled.load(std::memory_order_relaxed))
+		{
+			thread->events.push_back(e);
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+
+#include "../shared.hpp"
+
+
+// scoped zones saved in the Chrome trace event format (chrome://tracing, ui.perfetto.dev)
+// - the zones only get compiled in with SLUGGISH_TRACE, which the debug builds define
+// - nothing gets recorded until Trace_Open is called
+// - every thread records into its own buffer, the file gets written by Trace_Close
+//   or when the process exits
+#if defined(SLUGGISH_TRACE)
+#define TRACE_CONCAT2(a, b)		a##b
+#define TRACE_CONCAT(a, b)		TRACE_CONCAT2(a, b)
+#define TRACE_ZONE(name)		TraceZone TRACE_CONCAT(traceZone_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name)	Trace_SetThreadName(name)
+#else
+#define TRACE_ZONE(name)		((void)0)
+#define TRACE_THREAD_NAME(name)	((void)0)
+#endif
+
+// returns false when tracing was compiled out
+bool Trace_Open(const char* filePath);
+
+// stops the recording and writes the file
+// the other threads can still be running: the zones that end after this are dropped
+bool Trace_Close();
+
+// only the pointers are kept: the names must be string literals
+void Trace_SetThreadName(const char* name);
+
+struct TraceZone
+{
+	TraceZone(const char* name);
+	~TraceZone();
+
+	const char* name;
+	s64 start; // 0 when not recording
+};
@@ -25,6 +25,12 @@ abs_path_app = string.format("$(%s)", envvar_appdir)
 
 extra_warnings = 1
 
+newoption
+{
+	trigger = "trace",
+	description = "Compiles the Chrome trace zones into the release builds too"
+}
+
 local function GetBinDirName()
 
 	return "%{cfg.platform}/%{cfg.buildcfg}"
@@ -47,7 +53,7 @@ local function CreatePdbCopyPostBuildCommand(exeNameNoExt)
 
 end
 
-local function ApplyProjectSettings(exeNameNoExt)
+local function ApplyCommonSettings(targetNameNoExt)
 
 	--
 	-- General
@@ -64,7 +70,7 @@ local function ApplyProjectSettings(exeNameNoExt)
 	flags { "NoPCH", "StaticRuntime", "NoManifest", "NoNativeWChar" }
 
 	filter "configurations:debug"
-		defines { "DEBUG", "_DEBUG" }
+		defines { "DEBUG", "_DEBUG", "SLUGGISH_TRACE" }
 		flags { }
 
 	filter "configurations:release"
@@ -79,6 +85,9 @@ local function ApplyProjectSettings(exeNameNoExt)
 			"MultiProcessorCompile",
 			"NoRuntimeChecks"
 		}
+
+	filter { "configurations:release", "options:trace" }
+		defines { "SLUGGISH_TRACE" }
 	
 	filter {  }
 
@@ -113,13 +122,16 @@ local function ApplyProjectSettings(exeNameNoExt)
 
 	filter { }
 
-	targetname(exeNameNoExt)
+	targetname(targetNameNoExt)
 
-	files
-	{
-		path_src.."/*.cpp",
-		path_src.."/*.hpp"
-	}
+end
+
+local function ApplyProjectSettings(exeNameNoExt)
+
+	ApplyCommonSettings(exeNameNoExt)
+
+	-- everything but main lives in the library
+	links { "sluggish" }
 
 	-- copy the binaries over to the data install
 	-- it seems that "filter" doesn't work with "prebuildcommands", "postbuildcommands"
@@ -159,6 +171,16 @@ solution "Sluggish"
 	platforms { "x64" }
 	configurations { "debug", "release" }
 	
+	project "sluggish"
+		kind "StaticLib"
+		ApplyCommonSettings("sluggish")
+		AddProjectFolder("sluggish")
+		files
+		{
+			path_src.."/*.cpp",
+			path_src.."/*.hpp"
+		}
+
 	project "fontgen"
 		kind "ConsoleApp"
 		ApplyProjectSettings("fontgen")
@@ -177,3 +199,13 @@ solution "Sluggish"
 		includedirs { path_libs.."/SDL2/include", path_libs.."/GLEW/include" }
 		libdirs { path_libs.."/SDL2/lib", path_libs.."/GLEW/lib" }
 		links { "SDL2", "opengl32", "glew32" }
+
+	project "fontbench"
+		kind "ConsoleApp"
+		ApplyProjectSettings("fontbench")
+		AddProjectFolder("benchmark")
+
+	project "fontinspect"
+		kind "ConsoleApp"
+		ApplyProjectSettings("fontinspect")
+		AddProjectFolder("inspector")